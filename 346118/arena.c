@@ -0,0 +1,101 @@
+// Requested feature: posix_memalign
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "arena.h"
+
+/** Get the size class of the given size.
+ * @param size Size of a block (in bytes), non-zero
+ * @return Size class, 'ARENA_NB_CLASSES' or more if the block bypasses the free lists
+**/
+static inline size_t arena_class(size_t size) {
+    if (size <= (1ul << ARENA_MIN_CLASS))
+        return 0;
+    return (size_t) (64 - __builtin_clzl(size - 1)) - ARENA_MIN_CLASS;
+}
+
+void arena_init(struct arena* arena, bool retain) {
+    for (size_t i = 0; i < ARENA_NB_CLASSES; ++i)
+        atomic_init(&(arena->free[i]), NULL);
+    atomic_init(&(arena->deferred), NULL);
+    arena->retained = NULL;
+    arena->retain   = retain;
+}
+
+void arena_cleanup(struct arena* arena) {
+    arena_flush(arena);
+    for (size_t i = 0; i < ARENA_NB_CLASSES; ++i) {
+        struct arena_block* block = atomic_load_explicit(&(arena->free[i]), memory_order_relaxed);
+        while (block) {
+            struct arena_block* next = atomic_load_explicit(&(block->next), memory_order_relaxed);
+            free(block);
+            block = next;
+        }
+    }
+    while (arena->retained) {
+        struct arena_block* next = atomic_load_explicit(&(arena->retained->next), memory_order_relaxed);
+        free(arena->retained);
+        arena->retained = next;
+    }
+}
+
+void* arena_alloc(struct arena* arena, size_t size) {
+    size_t class = arena_class(size);
+    if (likely(class < ARENA_NB_CLASSES)) {
+        _Atomic(struct arena_block*)* head = arena->free + class;
+        struct arena_block* block = atomic_load_explicit(head, memory_order_acquire);
+        // Note: A popped block may be in use, and its link overwritten, by the
+        // time 'next' is read; the exchange then fails as blocks are not
+        // pushed back before the end of the epoch.
+        while (block && !atomic_compare_exchange_weak_explicit(head, &block, atomic_load_explicit(&(block->next), memory_order_relaxed), memory_order_acquire, memory_order_acquire));
+        if (block) {
+            atomic_store_explicit(&(block->next), NULL, memory_order_relaxed);
+            return block;
+        }
+        size = (size_t) 1 << (class + ARENA_MIN_CLASS); // Zero the whole block, for its later uses with a larger size
+    }
+    void* block;
+    if (unlikely(posix_memalign(&block, ARENA_ALIGN, size) != 0))
+        return NULL;
+    memset(block, 0, size);
+    return block;
+}
+
+void arena_defer(struct arena* arena, void* block, size_t size) {
+    struct arena_block* link = (struct arena_block*) block;
+    link->size = size;
+    struct arena_block* head = atomic_load_explicit(&(arena->deferred), memory_order_relaxed);
+    do {
+        atomic_store_explicit(&(link->next), head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&(arena->deferred), &head, link, memory_order_release, memory_order_relaxed));
+}
+
+void arena_flush(struct arena* arena) {
+    struct arena_block* block = atomic_exchange_explicit(&(arena->deferred), NULL, memory_order_acquire);
+    while (block) {
+        struct arena_block* next = atomic_load_explicit(&(block->next), memory_order_relaxed);
+        arena_free(arena, block, block->size); // Zeroed again if recycled
+        block = next;
+    }
+}
+
+void arena_free(struct arena* arena, void* block, size_t size) {
+    size_t class = arena_class(size);
+    if (unlikely(class >= ARENA_NB_CLASSES)) {
+        if (arena->retain) {
+            struct arena_block* link = (struct arena_block*) block;
+            atomic_store_explicit(&(link->next), arena->retained, memory_order_relaxed);
+            arena->retained = link;
+        } else {
+            free(block);
+        }
+        return;
+    }
+    memset(block, 0, size); // Bytes past 'size' were never written
+    struct arena_block* link = (struct arena_block*) block;
+    atomic_store_explicit(&(link->next), atomic_load_explicit(arena->free + class, memory_order_relaxed), memory_order_relaxed);
+    atomic_store_explicit(arena->free + class, link, memory_order_release);
+}
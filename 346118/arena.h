@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Alignment of every block handed out by an arena (in bytes).
+**/
+#define ARENA_ALIGN 64ul
+
+/** Base-2 logarithm of the size of the smallest size class (in bytes).
+**/
+#define ARENA_MIN_CLASS 6
+
+/** Number of size classes, each twice as large as the previous one; larger
+ *  blocks bypass the free lists.
+**/
+#define ARENA_NB_CLASSES 20
+
+/**
+ * @brief Free block of an arena, the link overlaying its first bytes.
+ */
+struct arena_block {
+    _Atomic(struct arena_block*) next; // Next free block of the same size class (or next deferred block)
+    size_t size; // Size the block was allocated with, only kept while deferred (in bytes)
+};
+
+/**
+ * @brief Arena of zeroed memory blocks, recycled through one free list per
+ * size class. Allocation is lock-free; blocks are only ever given back while
+ * no allocation is running (i.e. at the end of an epoch), so that concurrent
+ * allocations pop the free lists without ABA.
+ */
+struct arena {
+    _Atomic(struct arena_block*) free[ARENA_NB_CLASSES]; // Free blocks of each size class, zeroed but for their link
+    _Atomic(struct arena_block*) deferred; // Unused blocks given back while allocations may run, until the next flush
+    struct arena_block* retained; // Blocks larger than every size class, given back while 'retain' is set
+    bool retain; // Whether no block is given back to the system before cleanup
+};
+
+/** Initialize the given arena.
+ * @param arena  Arena to initialize
+ * @param retain Whether blocks larger than every size class are also kept until cleanup
+**/
+void arena_init(struct arena* arena, bool retain);
+
+/** Clean the given arena up, freeing its free and retained blocks.
+ * @param arena Arena to clean up
+**/
+void arena_cleanup(struct arena* arena);
+
+/** [thread-safe] Allocate a zeroed block, aligned on 'ARENA_ALIGN'.
+ * @param arena Arena to allocate from
+ * @param size  Size of the block (in bytes)
+ * @return Allocated block, NULL on allocation failure; 'free' releases it for good
+**/
+void* arena_alloc(struct arena* arena, size_t size);
+
+/** [thread-safe] Give back a block that was never written, while allocations
+ *  may run; it joins its free list on the next 'arena_flush'.
+ * @param arena Arena the block was allocated from
+ * @param block Block to give back
+ * @param size  Size the block was allocated with (in bytes)
+**/
+void arena_defer(struct arena* arena, void* block, size_t size);
+
+/** Move the blocks given back with 'arena_defer' to their free lists. Must not run concurrently with any other function on the arena.
+ * @param arena Arena to flush
+**/
+void arena_flush(struct arena* arena);
+
+/** Give the given block back to the arena. Must not run concurrently with any other function on the arena.
+ * @param arena Arena the block was allocated from
+ * @param block Block to give back
+ * @param size  Size the block was allocated with (in bytes)
+**/
+void arena_free(struct arena* arena, void* block, size_t size);
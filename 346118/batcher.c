@@ -0,0 +1,166 @@
+// Requested features: clock_gettime, syscall
+#define _GNU_SOURCE
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "macros.h"
+#include "batcher.h"
+
+/**
+ * @brief Epoch the calling thread last entered, so that it does not run two
+ * transactions in the same epoch.
+ */
+static _Thread_local struct {
+    struct batcher const* batcher; // Batcher entered (NULL for none)
+    uint32_t epoch; // Epoch entered
+} last = { NULL, 0 };
+
+/** Pause execution for a "short" period of time.
+**/
+static inline void short_pause(void) {
+#if defined(__i386__) || defined(__x86_64__)
+    _mm_pause();
+#endif
+}
+
+/** Get a field of the given state word.
+ * @param state State word
+ * @param unit  Unit of the field (e.g. 'BATCHER_SLOT')
+ * @param mask  Mask of the field, once shifted down
+ * @return Value of the field
+**/
+static inline uint64_t batcher_field(uint64_t state, uint64_t unit, uint64_t mask) {
+    return (state / unit) & mask;
+}
+
+/** Tell whether the given epoch is still the current epoch of the given batcher.
+ * @param batcher Batcher to query
+ * @param epoch   Epoch number
+ * @return Whether the epoch did not end yet
+**/
+static inline bool batcher_current(struct batcher* batcher, uint32_t epoch) {
+    return batcher_field(atomic_load_explicit(&(batcher->state), memory_order_acquire), BATCHER_EPOCH, BATCHER_EPOCH_MASK) == epoch;
+}
+
+/** Wait for the given epoch to end, spinning (and helping to end the epoch) then parking on the wake-up counter.
+ * @param batcher Batcher to wait on
+ * @param epoch   Epoch to wait the end of
+ * @param help    Function helping the end of the epoch, NULL for none
+ * @param arg     Argument to pass to 'help'
+**/
+static void batcher_wait(struct batcher* batcher, uint32_t epoch, void (*help)(void*), void* arg) {
+    for (unsigned int spins = 0; spins < BATCHER_SPIN_COUNT; ++spins) {
+        if (!batcher_current(batcher, epoch))
+            return;
+        if (help && (atomic_load_explicit(&(batcher->state), memory_order_relaxed) & BATCHER_ENDING))
+            help(arg);
+        short_pause();
+    }
+    atomic_fetch_add(&(batcher->sleepers), 1);
+    while (true) {
+        // Note: The last leaver starts the next epoch, then increments the
+        // counter, then reads 'sleepers' (all sequentially consistent), so
+        // either it sees this sleeper or the wait returns at once.
+        uint32_t wakes = atomic_load(&(batcher->wakes));
+        if (!batcher_current(batcher, epoch))
+            break;
+        syscall(SYS_futex, &(batcher->wakes), FUTEX_WAIT_PRIVATE, wakes, NULL, NULL, 0);
+    }
+    atomic_fetch_sub(&(batcher->sleepers), 1);
+}
+
+/** Adapt the write budget to the ending epoch, and reset the statistics for the next one.
+ * @param batcher Batcher whose epoch ends
+**/
+static void batcher_adapt(struct batcher* batcher) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t duration = (uint64_t) (now.tv_sec - batcher->start.tv_sec) * 1000000000ul + (uint64_t) now.tv_nsec - (uint64_t) batcher->start.tv_nsec;
+    size_t writers = atomic_load_explicit(&(batcher->writers), memory_order_relaxed);
+    size_t aborts  = atomic_load_explicit(&(batcher->aborts), memory_order_relaxed);
+    if (aborts * BATCHER_ABORTS_HIGH > writers || duration > BATCHER_TARGET_NS) {
+        batcher->budget /= 2;
+        if (batcher->budget < BATCHER_MIN_BUDGET)
+            batcher->budget = BATCHER_MIN_BUDGET;
+    } else if (writers > 0 && aborts * BATCHER_ABORTS_LOW <= writers) {
+        batcher->budget *= 2;
+        if (batcher->budget > BATCHER_MAX_BUDGET)
+            batcher->budget = BATCHER_MAX_BUDGET;
+    }
+    atomic_store_explicit(&(batcher->writers), 0, memory_order_relaxed);
+    atomic_store_explicit(&(batcher->aborts), 0, memory_order_relaxed);
+    batcher->start = now;
+}
+
+bool batcher_init(struct batcher* batcher) {
+    atomic_init(&(batcher->state), BATCHER_INITIAL_BUDGET * BATCHER_SLOT);
+    atomic_init(&(batcher->wakes), 0);
+    atomic_init(&(batcher->sleepers), 0);
+    atomic_init(&(batcher->writers), 0);
+    atomic_init(&(batcher->aborts), 0);
+    batcher->budget = BATCHER_INITIAL_BUDGET;
+    clock_gettime(CLOCK_MONOTONIC, &(batcher->start));
+    return true;
+}
+
+void batcher_cleanup(struct batcher* unused(batcher)) {
+}
+
+bool batcher_enter(struct batcher* batcher, bool is_ro, void (*help)(void*), void* arg) {
+    uint64_t state = atomic_load_explicit(&(batcher->state), memory_order_acquire);
+    while (true) {
+        uint32_t epoch  = (uint32_t) batcher_field(state, BATCHER_EPOCH, BATCHER_EPOCH_MASK);
+        uint64_t active = batcher_field(state, BATCHER_ACTIVE, BATCHER_COUNT_MASK);
+        bool ending = (state & BATCHER_ENDING) != 0;
+        bool joins  = !ending && (active == 0 || ( // No running epoch, start one right away
+            batcher_field(state, BATCHER_BLOCKED, BATCHER_COUNT_MASK) == 0 && !(last.batcher == batcher && last.epoch == epoch) &&
+            (is_ro || batcher_field(state, BATCHER_SLOT, BATCHER_SLOTS_MASK) > 0))); // Join the running epoch
+        uint64_t next = joins ? state + BATCHER_ACTIVE - (is_ro ? 0 : BATCHER_SLOT) : state + BATCHER_BLOCKED;
+        if (!atomic_compare_exchange_weak_explicit(&(batcher->state), &state, next, memory_order_acq_rel, memory_order_acquire))
+            continue;
+        if (joins) {
+            if (active == 0)
+                clock_gettime(CLOCK_MONOTONIC, &(batcher->start));
+        } else { // Wait for the next epoch, which counts this transaction as running
+            batcher_wait(batcher, epoch, help, arg);
+            epoch = (epoch + 1) & BATCHER_EPOCH_MASK;
+        }
+        last.batcher = batcher;
+        last.epoch   = epoch;
+        return true;
+    }
+}
+
+void batcher_leave(struct batcher* batcher, enum batcher_exit exit, void (*epoch_end)(void*), void* arg) {
+    if (exit != batcher_read_only) {
+        atomic_fetch_add_explicit(&(batcher->writers), 1, memory_order_relaxed);
+        if (exit == batcher_aborted)
+            atomic_fetch_add_explicit(&(batcher->aborts), 1, memory_order_relaxed);
+    }
+    uint64_t state = atomic_load_explicit(&(batcher->state), memory_order_relaxed);
+    uint64_t next;
+    do { // The last transaction to leave also marks the epoch as ending, so that no transaction enters before the end
+        next = state - BATCHER_ACTIVE;
+        if (batcher_field(state, BATCHER_ACTIVE, BATCHER_COUNT_MASK) == 1)
+            next |= BATCHER_ENDING;
+    } while (!atomic_compare_exchange_weak_explicit(&(batcher->state), &state, next, memory_order_acq_rel, memory_order_relaxed));
+    if (!(next & BATCHER_ENDING))
+        return;
+    epoch_end(arg);
+    batcher_adapt(batcher);
+    // Start the next epoch, running the waiting transactions
+    uint32_t epoch = (uint32_t) ((batcher_field(next, BATCHER_EPOCH, BATCHER_EPOCH_MASK) + 1) & BATCHER_EPOCH_MASK);
+    state = next;
+    do {
+        next = epoch * BATCHER_EPOCH + batcher->budget * BATCHER_SLOT + batcher_field(state, BATCHER_BLOCKED, BATCHER_COUNT_MASK) * BATCHER_ACTIVE;
+    } while (!atomic_compare_exchange_weak_explicit(&(batcher->state), &state, next, memory_order_acq_rel, memory_order_relaxed));
+    atomic_fetch_add(&(batcher->wakes), 1);
+    if (atomic_load(&(batcher->sleepers)) > 0)
+        syscall(SYS_futex, &(batcher->wakes), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
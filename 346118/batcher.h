@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/** Bounds and initial value of the write budget of an epoch.
+**/
+#define BATCHER_MIN_BUDGET 1
+#define BATCHER_MAX_BUDGET 1024
+#define BATCHER_INITIAL_BUDGET 16
+
+/** The budget halves after an epoch where more than 1/'BATCHER_ABORTS_HIGH'
+ *  of the read-write transactions aborted, or that lasted more than
+ *  'BATCHER_TARGET_NS', and doubles after an epoch where at most
+ *  1/'BATCHER_ABORTS_LOW' of them aborted.
+**/
+#define BATCHER_ABORTS_HIGH 4
+#define BATCHER_ABORTS_LOW 16
+#define BATCHER_TARGET_NS 1000000
+
+/** Number of pauses a transaction waiting for the next epoch spins before parking.
+**/
+#define BATCHER_SPIN_COUNT 128
+
+/** Layout of the state word of a batcher, from the lowest bits on: number of
+ *  running transactions (16 bits), number of transactions waiting for the
+ *  next epoch (16 bits), remaining write slots (11 bits), whether the epoch
+ *  is ending (1 bit) and epoch number (20 bits, wrapping around).
+**/
+#define BATCHER_ACTIVE       UINT64_C(1)
+#define BATCHER_BLOCKED      (UINT64_C(1) << 16)
+#define BATCHER_SLOT         (UINT64_C(1) << 32)
+#define BATCHER_ENDING       (UINT64_C(1) << 43)
+#define BATCHER_EPOCH        (UINT64_C(1) << 44)
+#define BATCHER_COUNT_MASK   UINT64_C(0xFFFF)
+#define BATCHER_SLOTS_MASK   UINT64_C(0x7FF)
+#define BATCHER_EPOCH_MASK   UINT64_C(0xFFFFF)
+
+/**
+ * @brief How a transaction leaves its epoch.
+ */
+enum batcher_exit {
+    batcher_read_only, // Read-only transaction (or read-write transaction that did not start)
+    batcher_committed, // Committed read-write transaction
+    batcher_aborted    // Aborted read-write transaction
+};
+
+/**
+ * @brief Batcher, grouping transactions into epochs. An epoch ends once every
+ * transaction that entered it has left. Transactions can join a running epoch,
+ * read-write ones within the write budget of the epoch, unless some are
+ * already waiting for the next epoch; a thread never runs two transactions in
+ * the same epoch. Entering and leaving are one compare-and-swap on the state
+ * word; waiting transactions spin, helping the last leaver to end the epoch,
+ * then park on a wake-up counter.
+ */
+struct batcher {
+    _Alignas(64) _Atomic(uint64_t) state; // Packed state (see 'BATCHER_ACTIVE' and below), alone in its cache line
+    _Alignas(64) _Atomic(uint32_t) wakes; // Number of epoch changes (wrapping around), incremented after every change of the state
+    _Atomic(uint32_t) sleepers; // Number of transactions parked on 'wakes'
+    _Atomic(size_t) writers; // Number of read-write transactions that left the current epoch
+    _Atomic(size_t) aborts;  // Number of those that aborted
+    size_t budget; // Slots given to each epoch, adapted by the last transaction leaving an epoch
+    struct timespec start; // Start time of the current epoch
+};
+
+/** Initialize the given batcher.
+ * @param batcher Batcher to initialize
+ * @return Whether the operation is a success
+**/
+bool batcher_init(struct batcher* batcher);
+
+/** Clean the given batcher up.
+ * @param batcher Batcher to clean up
+**/
+void batcher_cleanup(struct batcher* batcher);
+
+/** Join the current epoch if allowed, or else wait for the next epoch and enter it.
+ * @param batcher Batcher to enter
+ * @param is_ro   Whether the transaction is read-only
+ * @param help    Function helping the end of the epoch while waiting (called
+ *                repeatedly, concurrently with 'epoch_end'), NULL for none
+ * @param arg     Argument to pass to 'help'
+ * @return Whether the operation is a success
+**/
+bool batcher_enter(struct batcher* batcher, bool is_ro, void (*help)(void*), void* arg);
+
+/** Leave the current epoch. The last transaction to leave runs the given
+ *  function before the next epoch starts, while no transaction is running.
+ * @param batcher   Batcher to leave
+ * @param exit      How the transaction leaves
+ * @param epoch_end Function to run at the end of the epoch
+ * @param arg       Argument to pass to 'epoch_end'
+**/
+void batcher_leave(struct batcher* batcher, enum batcher_exit exit, void (*epoch_end)(void*), void* arg);
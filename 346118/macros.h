@@ -24,6 +24,17 @@
         (prop)
 #endif
 
+/** Define a function as always inlined, so that it is specialized for its constant arguments.
+**/
+#undef force_inline
+#ifdef __GNUC__
+    #define force_inline \
+        inline __attribute__((always_inline))
+#else
+    #define force_inline \
+        inline
+#endif
+
 /** Define a variable as unused.
 **/
 #undef unused
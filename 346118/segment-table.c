@@ -0,0 +1,53 @@
+#include <stdlib.h>
+
+#include "macros.h"
+#include "segment-table.h"
+
+bool segment_table_init(struct segment_table* table) {
+    table->slots = (struct segment*) calloc(SEGMENT_TABLE_SIZE, sizeof(struct segment));
+    if (!table->slots)
+        return false;
+    table->free_next = (size_t*) malloc(SEGMENT_TABLE_SIZE * sizeof(size_t));
+    if (!table->free_next) {
+        free(table->slots);
+        return false;
+    }
+    atomic_init(&(table->free_head), 0);
+    atomic_init(&(table->index), 0);
+    return true;
+}
+
+void segment_table_cleanup(struct segment_table* table) {
+    free(table->free_next);
+    free(table->slots);
+}
+
+struct segment* segment_table_insert(struct segment_table* table, char* words, size_t size) {
+    size_t slot;
+    size_t head = atomic_load_explicit(&(table->free_head), memory_order_acquire);
+    while (true) {
+        if (head == 0) { // No released slot, take a fresh one
+            slot = atomic_load_explicit(&(table->index), memory_order_relaxed);
+            do {
+                if (unlikely(slot >= SEGMENT_TABLE_SIZE))
+                    return NULL;
+            } while (!atomic_compare_exchange_weak_explicit(&(table->index), &slot, slot + 1, memory_order_relaxed, memory_order_relaxed));
+            break;
+        }
+        if (atomic_compare_exchange_weak_explicit(&(table->free_head), &head, table->free_next[head - 1], memory_order_acquire, memory_order_acquire)) {
+            slot = head - 1;
+            break;
+        }
+    }
+    struct segment* segment = table->slots + slot;
+    segment->size = size;
+    atomic_store_explicit(&(segment->words), words, memory_order_release);
+    return segment;
+}
+
+void segment_table_release(struct segment_table* table, struct segment* segment) {
+    size_t slot = (size_t) (segment - table->slots);
+    atomic_store_explicit(&(segment->words), NULL, memory_order_relaxed);
+    table->free_next[slot] = atomic_load_explicit(&(table->free_head), memory_order_relaxed);
+    atomic_store_explicit(&(table->free_head), slot + 1, memory_order_release);
+}
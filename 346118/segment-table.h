@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of low bits of a shared memory address holding the offset within
+ *  the segment, the high bits holding the segment identifier.
+**/
+#define SEGMENT_OFFSET_BITS 48
+
+/** Maximum number of segments simultaneously registered in a table. Segment
+ *  identifiers start at 1, so that no shared memory address is NULL.
+**/
+#define SEGMENT_TABLE_SIZE ((1ul << (64 - SEGMENT_OFFSET_BITS)) - 1)
+
+/**
+ * @brief Segment descriptor, i.e. one slot of a segment table.
+ */
+struct segment {
+    _Atomic(char*) words; // Arrays of the words (control words, copies A and copies B), NULL if the slot is unused
+    size_t size;          // Size of the segment (in bytes)
+};
+
+/**
+ * @brief Table of segment descriptors, preallocated once. Registration is
+ * lock-free; slots are only ever released while no transaction is running
+ * (i.e. at the end of an epoch), so that concurrent registrations pop the
+ * stack of released slots without ABA.
+ */
+struct segment_table {
+    struct segment* slots;      // Preallocated array of descriptors
+    size_t*         free_next;  // For each released slot, the next released slot plus one (0 for none)
+    _Atomic(size_t) free_head;  // Last released slot plus one (0 for none)
+    _Atomic(size_t) index;      // Number of slots ever used
+};
+
+/** Initialize the given table.
+ * @param table Table to initialize
+ * @return Whether the operation is a success
+**/
+bool segment_table_init(struct segment_table* table);
+
+/** Clean the given table up, the registered arrays of words are not freed.
+ * @param table Table to clean up
+**/
+void segment_table_cleanup(struct segment_table* table);
+
+/** [thread-safe] Register a new segment.
+ * @param table Table to register into
+ * @param words Array of words of the segment
+ * @param size  Size of the segment (in bytes)
+ * @return Descriptor of the registered segment, NULL if the table is full
+**/
+struct segment* segment_table_insert(struct segment_table* table, char* words, size_t size);
+
+/** Release the given descriptor. Must not run concurrently with any other function on the table.
+ * @param table   Table the descriptor belongs to
+ * @param segment Descriptor to release, whose array of words must already be freed
+**/
+void segment_table_release(struct segment_table* table, struct segment* segment);
+
+/** Get the number of slots ever used, i.e. the bound of the slots to iterate over.
+ * @param table Table to query
+ * @return Number of slots ever used
+**/
+static inline size_t segment_table_bound(struct segment_table* table) {
+    return atomic_load_explicit(&(table->index), memory_order_acquire);
+}
+
+/** Get the address in shared memory of the first byte of the given segment.
+ * @param table   Table the segment belongs to
+ * @param segment Registered segment
+ * @return Address of the segment in shared memory
+**/
+static inline void* segment_table_address(struct segment_table const* table, struct segment const* segment) {
+    return (void*) (((uintptr_t) (segment - table->slots) + 1) << SEGMENT_OFFSET_BITS);
+}
+
+/** Get the segment containing the given address in shared memory.
+ * @param table Table the segment belongs to
+ * @param addr  Address in shared memory
+ * @return Segment containing the address
+**/
+static inline struct segment* segment_table_get(struct segment_table* table, void const* addr) {
+    return table->slots + (((uintptr_t) addr >> SEGMENT_OFFSET_BITS) - 1);
+}
+
+/** Get the offset of the given address within its segment.
+ * @param addr Address in shared memory
+ * @return Offset within the segment (in bytes)
+**/
+static inline size_t segment_offset(void const* addr) {
+    return (uintptr_t) addr & ((1ul << SEGMENT_OFFSET_BITS) - 1);
+}
@@ -19,304 +19,977 @@
  *
  * @section DESCRIPTION
  *
- * Lock-based transaction manager implementation used as the reference.
+ * Dual-versioned transaction manager. Transactions are grouped into epochs by
+ * a batcher; every word has a readable copy, which is stable for the whole
+ * epoch, and a writable copy, which becomes readable at the end of the epoch
+ * if a committed transaction wrote it.
+ *
+ * Setting the environment variable 'TM_INVISIBLE_READS' (to anything but 0)
+ * lets read-only transactions run outside of the batcher: they read the
+ * readable copies as of the last ended epoch, validating every word against
+ * the epoch that published it, and never write to shared memory.
+ *
+ * Reads and writes are specialized for every word size from 1 to 32 bytes
+ * (any other size takes a generic path), and selected once in 'tm_create'.
 **/
 
-// Requested feature: posix_memalign
-#define _GNU_SOURCE
-#define _POSIX_C_SOURCE   200809L
 #ifdef __STDC_NO_ATOMICS__
     #error Current C11 compiler does not support atomic operations
 #endif
 
 // External headers
+#include <sched.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdlib.h>
-#include <stdbool.h>
-#include <stdio.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // Internal headers
 #include "../include/tm.h"
 
 #include "macros.h"
-#include "shared-lock.h"
+#include "arena.h"
+#include "batcher.h"
+#include "segment-table.h"
+#include "tx-pool.h"
+
+static const tx_t read_only_tx = UINTPTR_MAX - 10;
+
+/** Control word of a word, packing:
+ *  - 'control_valid_b': whether copy B (or else copy A) is the readable copy,
+ *  - 'control_written': whether the transaction in the access set wrote the word,
+ *  - 'control_owner':   the access set of the current epoch, i.e. 0 when
+ *    empty, the address of the only transaction in the set, or
+ *    'control_multiple' when more than one (read-write) transaction read it.
+**/
+typedef _Atomic(uint64_t) control_t;
+static const uint64_t control_valid_b  = 1;
+static const uint64_t control_written  = 2;
+static const uint64_t control_owner    = ~(uint64_t) 3;
+static const uint64_t control_multiple = ~(uint64_t) 3;
+
+/** Version of a word, i.e. the epoch at the end of which its readable copy was
+ *  published (0 if never written), only kept for invisible reads.
+**/
+typedef _Atomic(uint64_t) version_t;
+
+/** Number of consecutive aborts of invisible read-only transactions after
+ *  which a thread runs its next read-only transaction in the batcher.
+**/
+#define INVISIBLE_RETRIES 4
+
+/** Alignment of the arrays of a segment, so that they do not share cache lines.
+**/
+#define SEGMENT_ARRAY_ALIGN ARENA_ALIGN
+
+/** Number of logged words per chunk of the epoch-end pass, i.e. per unit of
+ *  work that the transactions waiting for the next epoch can take over.
+**/
+#define EPOCH_END_CHUNK 1024
+
+/**
+ * @brief Arrays of a segment from a given word on: the control words, then
+ * copy A and copy B of the data, each array being contiguous.
+ */
+struct words {
+    control_t* control; // Control word
+    version_t* version; // Version, NULL if invisible reads are disabled
+    char*      copy[2]; // Copy A and copy B
+};
 
-static const tx_t read_only_tx  = UINTPTR_MAX - 10;
-static const tx_t read_write_tx = UINTPTR_MAX - 11;
+/**
+ * @brief Grow-on-demand array of fixed-size elements.
+ */
+struct vector {
+    void*  data; // Elements
+    size_t size; // Number of elements in use
+    size_t cap;  // Number of allocated elements
+};
 
+/** Append one (uninitialized) element to the given vector.
+ * @param vec  Vector to append to
+ * @param elem Size of one element (in bytes)
+ * @return Address of the appended element, NULL on allocation failure
+**/
+static void* vector_push(struct vector* vec, size_t elem) {
+    if (unlikely(vec->size == vec->cap)) {
+        size_t cap = vec->cap == 0 ? 16 : 2 * vec->cap;
+        void* data = realloc(vec->data, cap * elem);
+        if (unlikely(!data))
+            return NULL;
+        vec->data = data;
+        vec->cap  = cap;
+    }
+    return (char*) vec->data + elem * vec->size++;
+}
 
-// Linked list of words!
-struct wordNode_instance_t {
-    
-    /*LINKED SECTION*/
-    struct wordNode_instance_t* prev;
-    struct wordNode_instance_t* next;
-    
-    /* CONTROL SECTION */
-    bool valid_a; 
-    bool accessed;
-    bool free; 
-    bool writing; 
+/**
+ * @brief Word whose access set a transaction joined first in the current
+ * epoch, to publish and reset at the end of the epoch.
+ */
+struct access {
+    control_t* control; // Control word
+    version_t* version; // Version, NULL if invisible reads are disabled
+};
+
+/**
+ * @brief Append-only log of the words whose access set a transaction joined
+ * first, handed over to the epoch when the transaction leaves it.
+ */
+struct access_log {
+    struct access_log* next; // Next log handed over to the same epoch
+    size_t size; // Number of logged words
+    size_t cap;  // Number of allocated entries
+    struct access entries[]; // Logged words
+};
 
-    void* copy_A;
-    void* copy_B;
+/**
+ * @brief Append-only log of segments; the log of the segments to free is
+ * handed over to the epoch when the transaction leaves it.
+ */
+struct segment_log {
+    struct segment_log* next; // Next log handed over to the same epoch
+    size_t size; // Number of logged segments
+    size_t cap;  // Number of allocated entries
+    struct segment* entries[]; // Logged segments
+};
 
+/**
+ * @brief Logged words to publish and reset at the end of an epoch.
+ */
+struct chunk {
+    struct access const* entries; // First logged word
+    size_t nb; // Number of logged words
 };
-typedef struct wordNode_instance_t* wordNode_t;
 
+struct region;
 
+/**
+ * @brief Reads and writes specialized for one word size.
+ */
+struct word_ops {
+    bool (*read)(struct region*, tx_t, void const*, size_t, void*);  // Implementation of 'tm_read'
+    bool (*write)(struct region*, tx_t, void const*, size_t, void*); // Implementation of 'tm_write'
+};
+
+/**
+ * @brief Shared memory region, i.e. transactional memory.
+ */
 struct region {
-    struct shared_lock_t lock; // Global (coarse-grained) lock
-    wordNode_t start;        // Start of the shared memory region (i.e., of the non-deallocable memory segment)
-    wordNode_t allocs; // Shared memory segments dynamically allocated via tm_alloc within transactions
-    size_t size;        // Size of the non-deallocable memory segment (in bytes)
-    size_t align;       // Size of a word in the shared memory region (in bytes)
+    struct batcher batcher; // Batcher grouping transactions into epochs
+    struct segment_table segments; // Registered shared memory segments, and naming scheme of their addresses
+    struct arena arena;     // Allocator of the arrays of the segments
+    struct segment* start;  // Non-deallocable memory segment
+    size_t size;   // Size of the non-deallocable memory segment (in bytes)
+    size_t align;  // Size of a word in the shared memory region (in bytes)
+    unsigned int shift; // Base-2 logarithm of 'align'
+    struct word_ops const* ops; // Reads and writes specialized for 'align'
+    bool invisible; // Whether read-only transactions run outside of the batcher
+    _Atomic(uint64_t) clock;     // Number of ended epochs
+    _Atomic(uint64_t) last_free; // Last epoch at the end of which segments were freed
+    _Atomic(struct access_log*) logs; // Logs handed over to the current epoch
+    _Atomic(struct segment_log*) frees; // Logs of the segments to free at the end of the current epoch
+    _Atomic(struct access_log*) spare_logs;   // Emptied access logs, for the transactions to take
+    _Atomic(struct segment_log*) spare_frees; // Emptied segment logs, for the transactions to take
+    struct vector chunks; // Chunks of the current epoch-end pass (struct chunk), only written by the last leaver
+    _Alignas(64) _Atomic(uint64_t) claim; // Next chunk of the pass to take (32 high bits) and number of chunks (32 low bits)
+    _Atomic(size_t) done; // Number of chunks of the pass processed
 };
 
-shared_t tm_create(size_t size, size_t align) {
-    struct region* region = (struct region*) malloc(sizeof(struct region));
-    wordNode_t start = (struct wordNode_instance_t*) calloc(1, sizeof(struct wordNode_instance_t));
+/**
+ * @brief Read-write transaction descriptor, recycled through the pool of the
+ * thread that ran it.
+ */
+struct tx {
+    struct tx_pool_link link; // Link in the pool of recycled descriptors
+    struct vector writes; // Control words of the words written by the transaction (control_t*)
+    struct access_log* accesses; // Words whose access set the transaction joined first, NULL if none taken yet
+    struct segment_log* allocs; // Segments allocated by the transaction, freed if it aborts, NULL if none taken yet
+    struct segment_log* frees;  // Segments freed by the transaction if it commits, NULL if none taken yet
+};
 
-    if (unlikely(!start)) return invalid_shared; // check for successfull memory allocation
-    if (unlikely(!region)) return invalid_shared; // check for successfull memory allocation
-        
+// -------------------------------------------------------------------------- //
 
-    if (!shared_lock_init(&(region->lock))) {
-        free(region->start);
-        free(region);
-        return invalid_shared;
-    }
+/** Round the given size up to a multiple of 'SEGMENT_ARRAY_ALIGN'.
+ * @param size Size to round (in bytes)
+ * @return Rounded size (in bytes)
+**/
+static inline size_t array_size(size_t size) {
+    return (size + SEGMENT_ARRAY_ALIGN - 1) & ~(SEGMENT_ARRAY_ALIGN - 1);
+}
 
+/** Get the size of the arrays of a segment of the given size.
+ * @param region Region the segment belongs to
+ * @param size   Size of the segment (in bytes)
+ * @return Size of the control words and both copies (in bytes)
+**/
+static inline size_t segment_bytes(struct region const* region, size_t size) {
+    size_t controls = array_size((size >> region->shift) * sizeof(control_t));
+    return (region->invisible ? 2 * controls : controls) + 2 * array_size(size);
+}
 
-    // start node
-    start->accessed = false;
-    start->free = false;
-    start->writing = false;
-    start->valid_a = true;
-    // start node copies
-    start->copy_A = (void*) calloc(1, size);
-    start->copy_B = (void*) calloc(1, size);
-    if (unlikely(!start->copy_A)) return invalid_shared; // check for successfull memory allocation
-    if (unlikely(!start->copy_B)) return invalid_shared; // check for successfull memory allocation
-    
-
-    // region
-    region->allocs = NULL;
-    region->size = size;
-    region->align = align;
+/** Allocate and register a zeroed segment.
+ * @param region Region the segment belongs to
+ * @param size   Size of the segment (in bytes)
+ * @return Registered segment, NULL on allocation failure
+**/
+static struct segment* segment_alloc(struct region* region, size_t size) {
+    char* words = (char*) arena_alloc(&(region->arena), segment_bytes(region, size));
+    if (unlikely(!words))
+        return NULL;
+    struct segment* segment = segment_table_insert(&(region->segments), words, size);
+    if (unlikely(!segment)) // Transactions may be running
+        arena_defer(&(region->arena), words, segment_bytes(region, size));
+    return segment;
+}
 
-    return region;
+/** Give the arrays of the given segment back to the arena and unregister it, while no transaction is running.
+ * @param region  Region the segment belongs to
+ * @param segment Segment to free
+**/
+static void segment_free(struct region* region, struct segment* segment) {
+    arena_free(&(region->arena), atomic_load_explicit(&(segment->words), memory_order_relaxed), segment_bytes(region, segment->size));
+    segment_table_release(&(region->segments), segment);
 }
 
-void tm_destroy(shared_t shared) {
-    printf("tm_destroy...\n");
-    // Note: To be compatible with any implementation, shared_t is defined as a
-    // void*. For this particular implementation, the "real" type of a shared_t
-    // is a struct region*.
-    struct region* region = (struct region*) shared;
-    while (region->allocs) { // Free allocated segments
-        wordNode_t tail = region->allocs->next;
-        free(region->allocs);
-        region->allocs = tail;
-    }
-    free(region->start);
-    shared_lock_cleanup(&(region->lock));
-    free(region);
+/** Get the arrays of a segment from the word at the given offset on.
+ * @param region Region the segment belongs to
+ * @param base   Block holding the arrays of the segment
+ * @param size   Size of the segment (in bytes)
+ * @param offset Offset of the word in the segment (in bytes)
+ * @param align  Size of a word (in bytes)
+ * @return Arrays of the segment from the word on
+**/
+static force_inline struct words words_of(struct region const* region, char* base, size_t size, size_t offset, size_t align) {
+    size_t controls = array_size(size / align * sizeof(control_t));
+    size_t index = offset / align;
+    struct words words;
+    words.control = (control_t*) base + index;
+    words.version = region->invisible ? (version_t*) (base + controls) + index : NULL;
+    words.copy[0] = base + (region->invisible ? 2 * controls : controls) + offset;
+    words.copy[1] = words.copy[0] + array_size(size);
+    return words;
 }
 
-// Note: In this particular implementation, tm_start returns a valid virtual
-// address (i.e., shared memory locations are virtually addressed).
-// This is NOT required. Indeed, as the content of shared memory is only ever
-// accessed via tm functions (read/write/free), you can use any naming scheme
-// you want to designate a word within the transactional memory as long as it
-// fits in a void*. Said functions will need to translate from a void* to a
-// specific word. Moreover, your naming scheme should support pointer arithmetic
-// (i.e., one should be able to pass tm_start(shared)+align*n to access the
-// (n+1)-th word within a memory region).
-// You can assume sizeof(void*) == 64b and that the maximum size ever allocated
-// will be 2^48.
-void* tm_start(shared_t shared) {
-    printf("tm_start...\n");
-    return ((struct region*) shared)->start;
+/** Get the arrays of the given segment from the word at the given offset on.
+ * @param region  Region the segment belongs to
+ * @param segment Segment to query
+ * @param offset  Offset of the word in the segment (in bytes)
+ * @param align   Size of a word (in bytes)
+ * @return Arrays of the segment from the word on
+**/
+static force_inline struct words words_at(struct region const* region, struct segment* segment, size_t offset, size_t align) {
+    return words_of(region, atomic_load_explicit(&(segment->words), memory_order_relaxed), segment->size, offset, align);
 }
 
-size_t tm_size(shared_t shared) {
-    printf("tm_size...\n");
-    return ((struct region*) shared)->size;
+/** Move the given arrays forward by the given number of words.
+ * @param words Arrays to move
+ * @param nb    Number of words to skip
+ * @param align Size of a word (in bytes)
+**/
+static force_inline void words_skip(struct words* words, size_t nb, size_t align) {
+    words->control += nb;
+    if (words->version)
+        words->version += nb;
+    words->copy[0] += nb * align;
+    words->copy[1] += nb * align;
 }
 
-size_t tm_align(shared_t shared) {
-    printf("tm_align...\n");
-    return ((struct region*) shared)->align;
+/** Copy the given number of words out of a copy in shared memory, loading single words of up to 8 bytes at once.
+ * @param target Target address (in a private region)
+ * @param source Source address (in a copy)
+ * @param nb     Number of words to copy
+ * @param align  Size of a word (in bytes)
+**/
+static force_inline void words_load(void* target, void const* source, size_t nb, size_t align) {
+    #define WORD_LOAD(type) { \
+        type word = __atomic_load_n((type const*) source, __ATOMIC_RELAXED); \
+        memcpy(target, &word, sizeof(type)); \
+        return; \
+    }
+    if (nb == 1) {
+        switch (align) {
+        case 1: WORD_LOAD(uint8_t)
+        case 2: WORD_LOAD(uint16_t)
+        case 4: WORD_LOAD(uint32_t)
+        case 8: WORD_LOAD(uint64_t)
+        default: break;
+        }
+    }
+    #undef WORD_LOAD
+    memcpy(target, source, nb * align);
 }
 
-tx_t tm_begin(shared_t shared, bool is_ro) {
-    printf("tm_begin...\n");
-    // We let read-only transactions run in parallel by acquiring a shared
-    // access. On the other hand, read-write transactions acquire an exclusive
-    // access. At any point in time, the lock can be shared between any number
-    // of read-only transactions or held by a single read-write transaction.
-    if (is_ro) {
-        // Note: "unlikely" is a macro that helps branch prediction.
-        // It tells the compiler (GCC) that the condition is unlikely to be true
-        // and to optimize the code with this additional knowledge.
-        // It of course penalizes executions in which the condition turns up to
-        // be true.
-        if (unlikely(!shared_lock_acquire_shared(&(((struct region*) shared)->lock))))
-            return invalid_tx;
-        return read_only_tx;
-    } else {
-        if (unlikely(!shared_lock_acquire(&(((struct region*) shared)->lock))))
-            return invalid_tx;
-        return read_write_tx;
+/** Copy the given number of words into a copy in shared memory, storing single words of up to 8 bytes at once.
+ * @param target Target address (in a copy)
+ * @param source Source address (in a private region)
+ * @param nb     Number of words to copy
+ * @param align  Size of a word (in bytes)
+**/
+static force_inline void words_store(void* target, void const* source, size_t nb, size_t align) {
+    #define WORD_STORE(type) { \
+        type word; \
+        memcpy(&word, source, sizeof(type)); \
+        __atomic_store_n((type*) target, word, __ATOMIC_RELAXED); \
+        return; \
+    }
+    if (nb == 1) {
+        switch (align) {
+        case 1: WORD_STORE(uint8_t)
+        case 2: WORD_STORE(uint16_t)
+        case 4: WORD_STORE(uint32_t)
+        case 8: WORD_STORE(uint64_t)
+        default: break;
+        }
     }
+    #undef WORD_STORE
+    memcpy(target, source, nb * align);
 }
 
-bool tm_end(shared_t shared, tx_t tx) {
-    printf("tm_end...\n");
-    if (tx == read_only_tx) {
-        shared_lock_release_shared(&(((struct region*) shared)->lock));
-    } else {
-        shared_lock_release(&(((struct region*) shared)->lock));
+/** Count the consecutive control words, from the given one on, that are equal to the given value once masked.
+ * @param control First control word
+ * @param nb      Maximum number of control words to compare
+ * @param mask    Mask to apply to each control word
+ * @param value   Value to compare the masked control words against
+ * @return Length of the run (at least 1 if the first control word matches)
+**/
+static size_t control_run(control_t const* control, size_t nb, uint64_t mask, uint64_t value) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Note: Control words are 8-byte aligned, and each 8-byte aligned half of
+    // a vector load is single-copy atomic on x86-64, so this compares the
+    // same values as relaxed loads would.
+    __m128i const vmask  = _mm_set1_epi64x((long long) mask);
+    __m128i const vvalue = _mm_set1_epi64x((long long) value);
+    for (; i + 2 <= nb; i += 2) {
+        __m128i pair = _mm_loadu_si128((__m128i const*) (control + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(pair, vmask), vvalue)) != 0xFFFF)
+            break;
     }
+#endif
+    while (i < nb && (atomic_load_explicit(control + i, memory_order_relaxed) & mask) == value)
+        ++i;
+    return i;
+}
+
+// Note: Emptied logs are only given back at the end of an epoch, while no
+// transaction takes any. A taken log may be in use, and reallocated, by the
+// time its 'next' is read; the exchange then fails, as in 'arena_alloc'.
+/** Take an emptied access log of the given region.
+ * @param region Region to take from
+ * @return Emptied log, NULL if none
+**/
+static struct access_log* access_log_take(struct region* region) {
+    struct access_log* log = atomic_load_explicit(&(region->spare_logs), memory_order_acquire);
+    while (log && !atomic_compare_exchange_weak_explicit(&(region->spare_logs), &log, log->next, memory_order_acquire, memory_order_acquire));
+    return log;
+}
+
+/** Take an emptied segment log of the given region.
+ * @param region Region to take from
+ * @return Emptied log, NULL if none
+**/
+static struct segment_log* segment_log_take(struct region* region) {
+    struct segment_log* log = atomic_load_explicit(&(region->spare_frees), memory_order_acquire);
+    while (log && !atomic_compare_exchange_weak_explicit(&(region->spare_frees), &log, log->next, memory_order_acquire, memory_order_acquire));
+    return log;
+}
+
+/** Make room for one more entry in the access log of the given transaction.
+ * @param region Region the transaction runs on
+ * @param tx     Transaction whose log to grow
+ * @return Whether the operation is a success
+**/
+static bool tx_log_reserve(struct region* region, struct tx* tx) {
+    struct access_log* log = tx->accesses;
+    if (likely(log && log->size < log->cap))
+        return true;
+    if (!log && (tx->accesses = access_log_take(region)))
+        return true;
+    size_t cap = log ? 2 * log->cap : 64;
+    log = (struct access_log*) realloc(log, sizeof(struct access_log) + cap * sizeof(struct access));
+    if (unlikely(!log))
+        return false;
+    if (!tx->accesses)
+        log->size = 0;
+    log->cap = cap;
+    tx->accesses = log;
     return true;
 }
 
-// Note: "unused" is a macro that tells the compiler that a variable is unused.
-bool tm_read(shared_t unused(shared), tx_t unused(tx), void const* source, size_t size, void* target) {
-    printf("tm_read...\n");
-    memcpy(target, source, size);
+/** Log a word whose access set the given transaction just joined first, room having been reserved.
+ * @param tx    Transaction whose log to append to
+ * @param words Arrays at the word
+**/
+static inline void tx_log(struct tx* tx, struct words const* words) {
+    struct access* entry = tx->accesses->entries + tx->accesses->size++;
+    entry->control = words->control;
+    entry->version = words->version;
+}
+
+/** Make room for one more entry in the given segment log.
+ * @param region Region the transaction owning the log runs on
+ * @param log    Log to grow, NULL if none taken yet
+ * @return Whether the operation is a success
+**/
+static bool segment_log_reserve(struct region* region, struct segment_log** log) {
+    struct segment_log* grown = *log;
+    if (likely(grown && grown->size < grown->cap))
+        return true;
+    if (!grown && (*log = segment_log_take(region)))
+        return true;
+    size_t cap = grown ? 2 * grown->cap : 16;
+    grown = (struct segment_log*) realloc(grown, sizeof(struct segment_log) + cap * sizeof(struct segment*));
+    if (unlikely(!grown))
+        return false;
+    if (!*log)
+        grown->size = 0;
+    grown->cap = cap;
+    *log = grown;
     return true;
 }
 
+/** Read the current word in the given read-write transaction.
+ * @param region Region the transaction runs on
+ * @param tx     Reading transaction
+ * @param words  Arrays at the word to read
+ * @param target Target address (in a private region)
+ * @param align  Size of a word (in bytes)
+ * @return Whether the transaction can continue
+**/
+static force_inline bool word_read(struct region* region, struct tx* tx, struct words const* words, void* target, size_t align) {
+    uint64_t const self = (uintptr_t) tx;
+    uint64_t control = atomic_load_explicit(words->control, memory_order_acquire);
+    while (true) {
+        uint64_t owner = control & control_owner;
+        if (control & control_written) { // Only the writer can read its own value
+            if (owner != self)
+                return false;
+            words_load(target, words->copy[!(control & control_valid_b)], 1, align);
+            return true;
+        }
+        if (owner == self || owner == control_multiple)
+            break;
+        if (owner == 0 && unlikely(!tx_log_reserve(region, tx)))
+            return false;
+        uint64_t desired = (control & control_valid_b) | (owner == 0 ? self : control_multiple);
+        if (atomic_compare_exchange_weak_explicit(words->control, &control, desired, memory_order_acq_rel, memory_order_acquire)) {
+            if (owner == 0) // The first reader logs the word for the whole access set
+                tx_log(tx, words);
+            break;
+        }
+    }
+    words_load(target, words->copy[control & control_valid_b], 1, align);
+    return true;
+}
 
+/** Write the current word in the given read-write transaction.
+ * @param region Region the transaction runs on
+ * @param tx     Writing transaction
+ * @param words  Arrays at the word to write
+ * @param source Source address (in a private region)
+ * @param align  Size of a word (in bytes)
+ * @return Whether the transaction can continue
+**/
+static force_inline bool word_write(struct region* region, struct tx* tx, struct words const* words, void const* source, size_t align) {
+    uint64_t const self = (uintptr_t) tx;
+    uint64_t control = atomic_load_explicit(words->control, memory_order_acquire);
+    if ((control & (control_owner | control_written)) != (self | control_written)) { // First write of this word by the transaction
+        control_t** entry = (control_t**) vector_push(&(tx->writes), sizeof(control_t*));
+        if (unlikely(!entry || !tx_log_reserve(region, tx))) {
+            if (entry)
+                --tx->writes.size;
+            return false;
+        }
+        *entry = words->control;
+        do {
+            uint64_t owner = control & control_owner;
+            if (owner != 0 && owner != self) { // Another transaction accessed the word
+                --tx->writes.size;
+                return false;
+            }
+        } while (!atomic_compare_exchange_weak_explicit(words->control, &control, (control & control_valid_b) | self | control_written, memory_order_acq_rel, memory_order_acquire));
+        if ((control & control_owner) == 0) // Not logged when read
+            tx_log(tx, words);
+    }
+    words_store(words->copy[!(control & control_valid_b)], source, 1, align);
+    return true;
+}
 
-void write_a_or_b(const void* unused(source), wordNode_t word_ptr, size_t size)
-{
+/** Publish the written copies and reset the access sets of the given chunk.
+ * @param chunk  Chunk to process
+ * @param epoch  Number of the ending epoch, i.e. version of the published copies
+**/
+static void chunk_epoch_end(struct chunk const* chunk, uint64_t epoch) {
+    // Note: A word is logged once more whenever an abort empties its access
+    // set and another transaction joins it; processing a word again, even
+    // concurrently, stores the same values.
+    for (size_t i = 0; i < chunk->nb; ++i) {
+        struct access const* access = chunk->entries + i;
+        uint64_t control = atomic_load_explicit(access->control, memory_order_relaxed);
+        if ((control & control_written) && access->version) // Versioned before the flip, for invisible readers that see the new readable copy
+            atomic_store_explicit(access->version, epoch, memory_order_relaxed);
+        atomic_store_explicit(access->control, (control & control_valid_b) ^ ((control & control_written) != 0), memory_order_release);
+    }
+}
 
-    // If copy_A is currently valid, that means we have to write into B
-    // This way people can still read from copy_A until we are done with copy_B
-    if(word_ptr ->valid_a)
-    {
+/** Process the chunks of the current epoch-end pass until none is left to take.
+ * @param arg Region whose epoch ends
+**/
+static void region_epoch_help(void* arg) {
+    struct region* region = (struct region*) arg;
+    uint64_t claim = atomic_load_explicit(&(region->claim), memory_order_acquire);
+    // Note: A pass is published at once, as the number of its chunks, so a
+    // successful claim always takes a chunk of the current pass, and the
+    // last leaver waits for every taken chunk before ending the epoch.
+    while ((claim >> 32) < (claim & UINT32_MAX)) {
+        if (!atomic_compare_exchange_weak_explicit(&(region->claim), &claim, claim + (UINT64_C(1) << 32), memory_order_acq_rel, memory_order_acquire))
+            continue;
+        uint64_t epoch = atomic_load_explicit(&(region->clock), memory_order_relaxed) + 1;
+        chunk_epoch_end((struct chunk const*) region->chunks.data + (claim >> 32), epoch);
+        atomic_fetch_add_explicit(&(region->done), 1, memory_order_release);
+        claim = atomic_load_explicit(&(region->claim), memory_order_acquire);
+    }
+}
+
+/** End the current epoch: publish the written copies and reset the access
+ *  sets of the logged words, along with the transactions waiting for the next
+ *  epoch, then release the freed segments.
+ * @param arg Region whose epoch ends, while no transaction is running
+**/
+static void region_epoch_end(void* arg) {
+    struct region* region = (struct region*) arg;
+    uint64_t epoch = atomic_load_explicit(&(region->clock), memory_order_relaxed) + 1;
+    struct access_log* logs = atomic_exchange_explicit(&(region->logs), NULL, memory_order_acquire);
+    region->chunks.size = 0;
+    for (struct access_log* log = logs; log; log = log->next) {
+        for (size_t first = 0; first < log->size; first += EPOCH_END_CHUNK) {
+            struct chunk chunk = { log->entries + first, log->size - first < EPOCH_END_CHUNK ? log->size - first : EPOCH_END_CHUNK };
+            struct chunk* entry = region->chunks.size < UINT32_MAX ? (struct chunk*) vector_push(&(region->chunks), sizeof(struct chunk)) : NULL;
+            if (unlikely(!entry)) { // Processed right away instead
+                chunk_epoch_end(&chunk, epoch);
+                continue;
+            }
+            *entry = chunk;
+        }
+    }
+    size_t chunks = region->chunks.size;
+    atomic_store_explicit(&(region->done), 0, memory_order_relaxed);
+    atomic_store_explicit(&(region->claim), (uint64_t) chunks, memory_order_release);
+    region_epoch_help(region);
+    while (atomic_load_explicit(&(region->done), memory_order_acquire) < chunks)
+        sched_yield(); // Wait for the chunks taken by the waiting transactions
+    while (logs) { // Given back to the transactions, no transaction running
+        struct access_log* next = logs->next;
+        logs->size = 0;
+        logs->next = atomic_load_explicit(&(region->spare_logs), memory_order_relaxed);
+        atomic_store_explicit(&(region->spare_logs), logs, memory_order_release);
+        logs = next;
+    }
+    struct segment_log* frees = atomic_exchange_explicit(&(region->frees), NULL, memory_order_acquire);
+    if (frees) { // Invisible readers of any segment fail their validation from now on
+        atomic_store_explicit(&(region->last_free), epoch, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+    }
+    while (frees) {
+        for (size_t i = 0; i < frees->size; ++i) {
+            struct segment* segment = frees->entries[i];
+            if (atomic_load_explicit(&(segment->words), memory_order_relaxed)) // Not freed through another log
+                segment_free(region, segment);
+        }
+        struct segment_log* next = frees->next;
+        frees->size = 0;
+        frees->next = atomic_load_explicit(&(region->spare_frees), memory_order_relaxed);
+        atomic_store_explicit(&(region->spare_frees), frees, memory_order_release);
+        frees = next;
+    }
+    arena_flush(&(region->arena));
+    atomic_store_explicit(&(region->clock), epoch, memory_order_release);
+}
 
-        // Copies bytes from source + offset, since we are currently on the k-th time copying from source
-        // Copies this into destination of copy_B, this is passed on from a for loop in the other function, so we don't need to keep track of this offset
-        memcpy(word_ptr->copy_B, source, size);
+/** Free the given pooled descriptor.
+ * @param link Link of the descriptor to free
+**/
+static void tx_free(struct tx_pool_link* link) {
+    struct tx* tx = (struct tx*) link;
+    free(tx->writes.data);
+    free(tx->accesses);
+    free(tx->allocs);
+    free(tx->frees);
+    free(tx);
+}
 
-        // Updates valid_a variable when we are done writing to the shared area, we now know it is updated
-        word_ptr ->valid_a = false;
+/** Hand the access log, and the log of the segments to free, of the given
+ *  (ended) read-write transaction over to the epoch, reset the transaction
+ *  and give it back to the pool of the calling thread.
+ * @param region    Region the transaction ran on
+ * @param tx        Transaction to release
+ * @param committed Whether the transaction committed, freeing its freed segments rather than its allocated ones
+**/
+static void tx_release(struct region* region, struct tx* tx, bool committed) {
+    // Note: The logs are taken by the last leaver, which only runs after this
+    // transaction leaves.
+    struct access_log* log = tx->accesses;
+    if (log && log->size > 0) {
+        log->next = atomic_load_explicit(&(region->logs), memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&(region->logs), &(log->next), log, memory_order_release, memory_order_relaxed));
+        tx->accesses = NULL;
     }
-    // If copy_B is currently valid, that means we have to write into A
-    // This way people can still read form Ccopy_B until we are done with copy_A
-    else
-    {
-
-        // Copies bytes from source + offset, since we are currently on the k-th time copying from source
-        // Copies this into destination of copy_B, this is passed on from a for loop in the other function, so we don't need to keep track of this offset
-        memcpy(word_ptr->copy_A, source, size);
-        // Updates valid_a variable when we are done writing to the shared area, we now know it is updated
-        word_ptr ->valid_a = true;
+    struct segment_log** frees = committed ? &(tx->frees) : &(tx->allocs);
+    struct segment_log* kept   = committed ? tx->allocs : tx->frees;
+    if (*frees && (*frees)->size > 0) {
+        (*frees)->next = atomic_load_explicit(&(region->frees), memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&(region->frees), &((*frees)->next), *frees, memory_order_release, memory_order_relaxed));
+        *frees = NULL;
     }
+    if (kept)
+        kept->size = 0;
+    tx->writes.size = 0;
+    tx_pool_give(&(tx->link), tx_free);
 }
 
+/** Abort the given read-write transaction, rolling back its accesses, and leave the epoch.
+ * @param region Region the transaction runs on
+ * @param tx     Transaction to abort
+**/
+static void tx_abort(struct region* region, struct tx* tx) {
+    control_t** writes = (control_t**) tx->writes.data;
+    for (size_t i = 0; i < tx->writes.size; ++i) // No other transaction can have joined the access set since the write
+        atomic_store_explicit(writes[i], atomic_load_explicit(writes[i], memory_order_relaxed) & control_valid_b, memory_order_release);
+    tx_release(region, tx, false);
+    batcher_leave(&(region->batcher), batcher_aborted, region_epoch_end, region);
+}
 
-bool write_word(const void* unused(source), wordNode_t word_ptr, size_t size)
-{
-    // If a word has been written in the current epoch, i.e. if someone is currently writing
-    if(word_ptr ->writing)
-    {   
-        // For later we can say that if anyone is current writing we just return false here,
-        // then we can optimize this later
-        // How to distinguish if a word is in the current access set or not given our current solution
+/** Tell whether the given transaction is an invisible read-only transaction,
+ *  whose identifier is its snapshot shifted left, plus one.
+ * @param tx Transaction to query
+ * @return Whether the transaction is invisible
+**/
+static inline bool tx_invisible(tx_t tx) {
+    return (tx & 1) && tx != read_only_tx;
+}
+
+/** Consecutive aborts of the invisible read-only transactions of the calling thread.
+**/
+static _Thread_local unsigned int invisible_aborts = 0;
+
+/** Read in an invisible read-only transaction, validating every word against its snapshot.
+ * @param region   Region to read from
+ * @param snapshot Number of the epochs ended when the transaction began
+ * @param source   Source start address (in the shared region)
+ * @param size     Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target   Target start address (in a private region)
+ * @param align    Size of a word (in bytes)
+ * @return Whether the transaction can continue
+**/
+static force_inline bool read_invisible(struct region* region, uint64_t snapshot, void const* source, size_t size, void* target, size_t align) {
+    // Note: The segment may be concurrently freed and its slot reused. Blocks
+    // are not given back to the system before tm_destroy, and a block always
+    // fits the sizes of all the segments it held, so reading from a stale
+    // block stays in bounds; such reads then fail on 'last_free'.
+    struct segment* segment = segment_table_get(&(region->segments), source);
+    char* base = atomic_load_explicit(&(segment->words), memory_order_acquire);
+    size_t segment_size = segment->size;
+    atomic_thread_fence(memory_order_acquire);
+    if (unlikely(!base || atomic_load_explicit(&(segment->words), memory_order_relaxed) != base || segment_offset(source) + size > segment_size))
         return false;
-        
-    }
-    else
-    {
-        if(word_ptr ->accessed)
-        {
-            return false;
+    struct words words = words_of(region, base, segment_size, segment_offset(source), align);
+    size_t nb = size / align;
+    while (nb > 0) {
+        uint64_t valid = atomic_load_explicit(words.control, memory_order_relaxed) & control_valid_b;
+        size_t run = control_run(words.control, nb, control_valid_b, valid);
+        atomic_thread_fence(memory_order_acquire); // A flipped control word implies a new version
+        words_load(target, words.copy[valid], run, align);
+        atomic_thread_fence(memory_order_acquire); // Copies overwritten since the snapshot imply a new version
+        for (size_t i = 0; i < run; ++i) {
+            if (atomic_load_explicit(words.version + i, memory_order_relaxed) > snapshot)
+                return false;
         }
-        else
-        {
-            write_a_or_b(source, word_ptr, size);
-            if(word_ptr -> accessed) 
-                word_ptr -> accessed = true;
-            word_ptr ->writing = true;
+        target = (char*) target + run * align;
+        words_skip(&words, run, align);
+        nb -= run;
+    }
+    return atomic_load_explicit(&(region->last_free), memory_order_relaxed) <= snapshot;
+}
+
+// Note: Reads and writes proceed by runs of consecutive words sharing the
+// same control word, whose copies are contiguous and can be copied at once;
+// only the words whose access set must change are handled one by one.
+/** Read in the given transaction, for the given word size.
+ * @param region Region to read from
+ * @param tx     Reading transaction
+ * @param source Source start address (in the shared region)
+ * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
+ * @param target Target start address (in a private region)
+ * @param align  Size of a word (in bytes)
+ * @return Whether the transaction can continue
+**/
+static force_inline bool tx_read(struct region* region, tx_t tx, void const* source, size_t size, void* target, size_t align) {
+    if (tx_invisible(tx)) {
+        if (likely(read_invisible(region, tx >> 1, source, size, target, align)))
             return true;
+        ++invisible_aborts;
+        return false;
+    }
+    struct words words = words_at(region, segment_table_get(&(region->segments), source), segment_offset(source), align);
+    size_t nb = size / align;
+    if (tx == read_only_tx) { // Read-only transactions only ever see the readable copies
+        while (nb > 0) {
+            uint64_t valid = atomic_load_explicit(words.control, memory_order_relaxed) & control_valid_b;
+            size_t run = control_run(words.control, nb, control_valid_b, valid);
+            words_load(target, words.copy[valid], run, align);
+            target = (char*) target + run * align;
+            words_skip(&words, run, align);
+            nb -= run;
         }
+        return true;
     }
+    uint64_t const self = (uintptr_t) tx;
+    while (nb > 0) {
+        uint64_t control = atomic_load_explicit(words.control, memory_order_acquire);
+        uint64_t owner = control & control_owner;
+        size_t run = 1;
+        if (owner == self && (control & control_written)) { // Words written by this transaction
+            run = control_run(words.control, nb, ~(uint64_t) 0, control);
+            words_load(target, words.copy[!(control & control_valid_b)], run, align);
+        } else if (owner == self || owner == control_multiple) { // Words whose access set already blocks other writers
+            run = control_run(words.control, nb, ~(uint64_t) 0, control);
+            words_load(target, words.copy[control & control_valid_b], run, align);
+        } else if (!word_read(region, (struct tx*) tx, &words, target, align)) {
+            tx_abort(region, (struct tx*) tx);
+            return false;
+        }
+        target = (char*) target + run * align;
+        words_skip(&words, run, align);
+        nb -= run;
+    }
+    return true;
 }
 
-/** [thread-safe] Write operation in the given transaction, source in a private region and target in the shared region.
- * @param shared Shared memory region associated with the transaction
- * @param tx     Transaction to use
+/** Write in the given read-write transaction, for the given word size.
+ * @param region Region to write to
+ * @param tx     Writing transaction
  * @param source Source start address (in a private region)
  * @param size   Length to copy (in bytes), must be a positive multiple of the alignment
  * @param target Target start address (in the shared region)
- * @return Whether the whole transaction can continue
+ * @param align  Size of a word (in bytes)
+ * @return Whether the transaction can continue
 **/
-bool tm_write(shared_t unused(shared), tx_t unused(tx), void const* unused(source), size_t unused(size), void* unused(target)) {
-    // TODO: tm_write(shared_t, tx_t, void const*, size_t, void*)
-    
-    printf("tm_write...\n");
-
-
-    printf("Size of size var: %zu\n", size);
-    
-    bool result = write_word(source, (wordNode_t)target, size);
-    
-    return result;
+static force_inline bool tx_write(struct region* region, tx_t tx, void const* source, size_t size, void* target, size_t align) {
+    struct words words = words_at(region, segment_table_get(&(region->segments), target), segment_offset(target), align);
+    size_t nb = size / align;
+    uint64_t const self = (uintptr_t) tx;
+    while (nb > 0) {
+        uint64_t control = atomic_load_explicit(words.control, memory_order_acquire);
+        size_t run = 1;
+        if ((control & control_owner) == self && (control & control_written)) { // Words already written by this transaction
+            run = control_run(words.control, nb, ~(uint64_t) 0, control);
+            words_store(words.copy[!(control & control_valid_b)], source, run, align);
+        } else if (!word_write(region, (struct tx*) tx, &words, source, align)) {
+            tx_abort(region, (struct tx*) tx);
+            return false;
+        }
+        source = (char const*) source + run * align;
+        words_skip(&words, run, align);
+        nb -= run;
+    }
+    return true;
 }
 
+/** Define the reads and writes specialized for the given word size.
+ * @param name  Suffix of the specialized functions
+ * @param align Size of a word (in bytes), constant for the specializations
+**/
+#define WORD_OPS(name, align) \
+    static bool tx_read_##name(struct region* region, tx_t tx, void const* source, size_t size, void* target) { \
+        return tx_read(region, tx, source, size, target, (align)); \
+    } \
+    static bool tx_write_##name(struct region* region, tx_t tx, void const* source, size_t size, void* target) { \
+        return tx_write(region, tx, source, size, target, (align)); \
+    }
+WORD_OPS(1, 1)
+WORD_OPS(2, 2)
+WORD_OPS(4, 4)
+WORD_OPS(8, 8)
+WORD_OPS(16, 16)
+WORD_OPS(32, 32)
+WORD_OPS(any, region->align)
+#undef WORD_OPS
+
+/** Specialized reads and writes, indexed by the base-2 logarithm of the word size.
+**/
+static struct word_ops const word_ops[] = {
+    { tx_read_1,  tx_write_1 },
+    { tx_read_2,  tx_write_2 },
+    { tx_read_4,  tx_write_4 },
+    { tx_read_8,  tx_write_8 },
+    { tx_read_16, tx_write_16 },
+    { tx_read_32, tx_write_32 }
+};
+static struct word_ops const word_ops_any = { tx_read_any, tx_write_any };
 
+// -------------------------------------------------------------------------- //
 
-alloc_t tm_alloc(shared_t shared, tx_t unused(tx), size_t size, void** target) {
-    // We allocate the dynamic segment such that its words are correctly
-    // aligned. Moreover, the alignment of the 'next' and 'prev' pointers must
-    // be satisfied. Thus, we use align on max(align, struct wordNode_t*).
+shared_t tm_create(size_t size, size_t align) {
+    struct region* region = (struct region*) malloc(sizeof(struct region));
+    if (unlikely(!region))
+        return invalid_shared;
+    char const* invisible = getenv("TM_INVISIBLE_READS");
+    region->size  = size;
+    region->align = align;
+    region->shift = 0;
+    while ((size_t) 1 << region->shift < align)
+        ++region->shift;
+    region->ops = region->shift < sizeof(word_ops) / sizeof(word_ops[0]) ? word_ops + region->shift : &word_ops_any;
+    region->invisible = invisible && *invisible && strcmp(invisible, "0") != 0;
+    atomic_init(&(region->clock), 0);
+    atomic_init(&(region->last_free), 0);
+    atomic_init(&(region->logs), NULL);
+    atomic_init(&(region->frees), NULL);
+    atomic_init(&(region->spare_logs), NULL);
+    atomic_init(&(region->spare_frees), NULL);
+    region->chunks.data = NULL;
+    region->chunks.size = 0;
+    region->chunks.cap  = 0;
+    atomic_init(&(region->claim), 0);
+    atomic_init(&(region->done), 0);
+    if (unlikely(!segment_table_init(&(region->segments)))) {
+        free(region);
+        return invalid_shared;
+    }
+    arena_init(&(region->arena), region->invisible); // Invisible readers may read freed blocks
+    region->start = segment_alloc(region, size);
+    if (unlikely(!region->start)) {
+        segment_table_cleanup(&(region->segments));
+        arena_cleanup(&(region->arena));
+        free(region);
+        return invalid_shared;
+    }
+    if (unlikely(!batcher_init(&(region->batcher)))) {
+        segment_free(region, region->start);
+        segment_table_cleanup(&(region->segments));
+        arena_cleanup(&(region->arena));
+        free(region);
+        return invalid_shared;
+    }
+    return region;
+}
 
-    printf("Working...1\n");
-    size_t align = ((struct region*) shared)->align;
-    align = align < sizeof(struct wordNode_t*) ? sizeof(void*) : align;
-    
-    printf("Working...1\n");
+void tm_destroy(shared_t shared) {
+    struct region* region = (struct region*) shared;
+    size_t bound = segment_table_bound(&(region->segments));
+    for (size_t i = 0; i < bound; ++i) // Free allocated segments
+        free(atomic_load_explicit(&(region->segments.slots[i].words), memory_order_relaxed));
+    segment_table_cleanup(&(region->segments));
+    arena_cleanup(&(region->arena));
+    batcher_cleanup(&(region->batcher));
+    for (struct access_log* log = atomic_load_explicit(&(region->spare_logs), memory_order_relaxed); log;) {
+        struct access_log* next = log->next;
+        free(log);
+        log = next;
+    }
+    for (struct segment_log* log = atomic_load_explicit(&(region->spare_frees), memory_order_relaxed); log;) {
+        struct segment_log* next = log->next;
+        free(log);
+        log = next;
+    }
+    free(region->chunks.data);
+    free(region);
+}
 
-    struct wordNode_instance_t* sn;
+// Note: Shared memory is virtually addressed: the 16 high bits of an address
+// hold the segment identifier and the 48 low bits the offset within the
+// segment, so that finding the control of a word is a table lookup plus an
+// index computation.
+void* tm_start(shared_t shared) {
+    struct region* region = (struct region*) shared;
+    return segment_table_address(&(region->segments), region->start);
+}
 
-    printf("Working...2\n");
+size_t tm_size(shared_t shared) {
+    return ((struct region*) shared)->size;
+}
 
-    if (unlikely(posix_memalign((void**)&sn, align, sizeof(struct wordNode_instance_t) + size) != 0)) // Allocation failed
-        return nomem_alloc;
+size_t tm_align(shared_t shared) {
+    return ((struct region*) shared)->align;
+}
 
-    printf("Working...3\n");
+tx_t tm_begin(shared_t shared, bool is_ro) {
+    struct region* region = (struct region*) shared;
+    if (is_ro && region->invisible && invisible_aborts < INVISIBLE_RETRIES)
+        return (tx_t) (atomic_load_explicit(&(region->clock), memory_order_acquire) << 1 | 1);
+    if (unlikely(!batcher_enter(&(region->batcher), is_ro, region_epoch_help, region)))
+        return invalid_tx;
+    if (is_ro)
+        return read_only_tx;
+    // Note: Descriptors, and their logs but for the access log handed over
+    // to the epoch, are reused across the transactions (and retries) of a
+    // thread. The batcher never lets a thread run two
+    // transactions in the same epoch, so a recycled address never meets the
+    // access sets left by its previous use, which are reset at the end of
+    // every epoch.
+    struct tx* tx = (struct tx*) tx_pool_take();
+    if (!tx)
+        tx = (struct tx*) calloc(1, sizeof(struct tx));
+    if (unlikely(!tx)) {
+        batcher_leave(&(region->batcher), batcher_read_only, region_epoch_end, region);
+        return invalid_tx;
+    }
+    return (tx_t) tx;
+}
 
-    // Insert in the linked list
-    sn->prev = NULL;
-    sn->next = ((struct region*) shared)->allocs;
-    if (sn->next) sn->next->prev = sn;
-    ((struct region*) shared)->allocs = sn;
+bool tm_end(shared_t shared, tx_t tx) {
+    struct region* region = (struct region*) shared;
+    if (tx_invisible(tx)) { // Every read was already validated against the snapshot
+        invisible_aborts = 0;
+        return true;
+    }
+    if (tx == read_only_tx) {
+        invisible_aborts = 0;
+        batcher_leave(&(region->batcher), batcher_read_only, region_epoch_end, region);
+        return true;
+    }
+    struct tx* t = (struct tx*) tx;
+    tx_release(region, t, true);
+    batcher_leave(&(region->batcher), batcher_committed, region_epoch_end, region);
+    return true;
+}
 
-    printf("Working...4\n");
+bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    struct region* region = (struct region*) shared;
+    return region->ops->read(region, tx, source, size, target);
+}
 
-    void* segment = (void*) ((uintptr_t) sn + sizeof(struct wordNode_instance_t));
-    memset(segment, 0, size);
-    *target = segment;
+bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    struct region* region = (struct region*) shared;
+    return region->ops->write(region, tx, source, size, target);
+}
 
-    printf("Working...5\n");
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    if (unlikely(!segment_log_reserve(region, &(t->allocs))))
+        return nomem_alloc;
+    struct segment* segment = segment_alloc(region, size);
+    if (unlikely(!segment))
+        return nomem_alloc;
+    t->allocs->entries[t->allocs->size++] = segment;
+    *target = segment_table_address(&(region->segments), segment);
     return success_alloc;
 }
 
-bool tm_free(shared_t shared, tx_t unused(tx), void* segment) {
-    struct wordNode_instance_t* sn = (struct wordNode_instance_t*) ((uintptr_t) segment - sizeof(struct wordNode_instance_t));
-
-    // Remove from the linked list
-    if (sn->prev) sn->prev->next = sn->next;
-    else ((struct region*) shared)->allocs = sn->next;
-    if (sn->next) sn->next->prev = sn->prev;
-
-    free(sn);
+bool tm_free(shared_t shared, tx_t tx, void* target) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    struct segment* segment = segment_table_get(&(region->segments), target);
+    if (unlikely(segment == region->start || !segment_log_reserve(region, &(t->frees)))) {
+        tx_abort(region, t);
+        return false;
+    }
+    t->frees->entries[t->frees->size++] = segment;
     return true;
 }
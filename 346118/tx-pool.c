@@ -0,0 +1,61 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "tx-pool.h"
+
+/**
+ * @brief Per-thread pool of transaction descriptors.
+ */
+struct tx_pool {
+    struct tx_pool_link* head; // Last descriptor given back
+    void (*release)(struct tx_pool_link*); // Function freeing a descriptor
+    bool registered; // Whether the pool is released on thread exit
+};
+
+static _Thread_local struct tx_pool pool = { NULL, NULL, false };
+
+static pthread_key_t  pool_key; // Key whose destructor releases the pool of an exiting thread
+static pthread_once_t pool_key_once = PTHREAD_ONCE_INIT;
+static bool           pool_key_valid = false;
+
+/** Release every descriptor of the given pool.
+ * @param arg Pool to release
+**/
+static void tx_pool_release(void* arg) {
+    struct tx_pool* p = (struct tx_pool*) arg;
+    while (p->head) {
+        struct tx_pool_link* next = p->head->next;
+        p->release(p->head);
+        p->head = next;
+    }
+}
+
+static void tx_pool_key_create(void) {
+    pool_key_valid = pthread_key_create(&pool_key, tx_pool_release) == 0;
+}
+
+// Note: The destructor of the key must not run once this library is unloaded.
+static void __attribute__((destructor)) tx_pool_key_delete(void) {
+    if (pool_key_valid)
+        pthread_key_delete(pool_key);
+}
+
+struct tx_pool_link* tx_pool_take(void) {
+    struct tx_pool_link* link = pool.head;
+    if (link)
+        pool.head = link->next;
+    return link;
+}
+
+void tx_pool_give(struct tx_pool_link* link, void (*release)(struct tx_pool_link*)) {
+    if (!pool.registered) {
+        pthread_once(&pool_key_once, tx_pool_key_create);
+        if (pool_key_valid)
+            pthread_setspecific(pool_key, &pool);
+        pool.registered = true;
+    }
+    pool.release = release;
+    link->next = pool.head;
+    pool.head  = link;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+/**
+ * @brief Link of a transaction descriptor in a pool, to embed as the first
+ * member of the descriptor.
+ */
+struct tx_pool_link {
+    struct tx_pool_link* next;
+};
+
+/** [thread-safe] Take a descriptor from the calling thread's pool.
+ * @return Recycled descriptor, NULL if the pool is empty
+**/
+struct tx_pool_link* tx_pool_take(void);
+
+/** [thread-safe] Give a (reset) descriptor back to the calling thread's pool.
+ * @param link    Link of the descriptor
+ * @param release Function freeing a descriptor, called on every pooled descriptor when the thread exits
+**/
+void tx_pool_give(struct tx_pool_link* link, void (*release)(struct tx_pool_link*));
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of objects a record retires before leaving tries to advance the epoch.
+**/
+#define EBR_BATCH 64
+
+/**
+ * @brief Object retired in some epoch, with the function releasing it.
+ */
+struct ebr_retired {
+    void* object; // Retired object
+    void (*release)(void*, void*); // Function releasing the object, called with 'arg' then 'object'
+    void* arg; // First argument of 'release'
+};
+
+/**
+ * @brief Objects retired in one epoch, i.e. a limbo list.
+ */
+struct ebr_limbo {
+    uint64_t epoch; // Epoch the objects were retired in
+    struct ebr_retired* objects; // Retired objects
+    size_t size; // Number of retired objects
+    size_t cap;  // Number of allocated entries
+};
+
+/**
+ * @brief Per-thread state of the epoch-based reclamation, alone in its cache
+ * line. A record is claimed by one thread at a time, between 'ebr_enter' and
+ * 'ebr_leave', and only freed with its domain.
+ */
+struct ebr_record {
+    _Alignas(64) _Atomic(uint64_t) announced; // Epoch observed when entering, 'EBR_QUIESCENT' outside of a critical section
+    _Atomic(bool) used; // Whether a thread claimed the record
+    struct ebr_record* next; // Next record of the domain
+    struct ebr_limbo limbo[3]; // Objects retired in the last three epochs the record was used in
+    size_t pending; // Objects retired since the record last tried to advance the epoch
+};
+
+/**
+ * @brief Domain of the epoch-based reclamation: an object retired in epoch e
+ * is released once the global epoch reaches e + 2, i.e. once every critical
+ * section that may have observed it has ended.
+ */
+struct ebr {
+    _Alignas(64) _Atomic(uint64_t) epoch; // Global epoch, alone in its cache line
+    _Atomic(struct ebr_record*) records; // Last allocated record
+    uint64_t id; // Unique identifier of the domain, naming it in the per-thread hints
+};
+
+/** Initialize the given domain.
+ * @param ebr Domain to initialize
+**/
+void ebr_init(struct ebr* ebr);
+
+/** Clean the given domain up, releasing every retired object, while no thread is in a critical section.
+ * @param ebr Domain to clean up
+**/
+void ebr_cleanup(struct ebr* ebr);
+
+/** [thread-safe] Enter a critical section, releasing the objects the claimed record retired long enough ago.
+ * @param ebr Domain to enter
+ * @return Record of the critical section, NULL on allocation failure
+**/
+struct ebr_record* ebr_enter(struct ebr* ebr);
+
+/** [thread-safe] Leave the critical section of the given record, trying to advance the epoch if enough objects were retired.
+ * @param ebr    Domain to leave
+ * @param record Record of the critical section
+**/
+void ebr_leave(struct ebr* ebr, struct ebr_record* record);
+
+/** [thread-safe] Retire the given (unreachable) object, in the critical section of the given record.
+ *  The object is leaked if the limbo list cannot grow.
+ * @param record  Record of the critical section
+ * @param object  Object to retire
+ * @param release Function releasing the object
+ * @param arg     First argument of 'release'
+**/
+void ebr_retire(struct ebr_record* record, void* object, void (*release)(void*, void*), void* arg);
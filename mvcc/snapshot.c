@@ -0,0 +1,91 @@
+// Requested feature: posix_memalign
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+
+#include "macros.h"
+#include "snapshot.h"
+
+static _Atomic(uint64_t) next_id = 0; // Identifier of the next registry
+
+/**
+ * @brief Record last used by the calling thread, tried first by its next transaction.
+ */
+static _Thread_local struct {
+    uint64_t registry; // Identifier of the registry of the record (0 for none)
+    struct snapshot_record* record;
+} hint = { 0, NULL };
+
+void snapshot_registry_init(struct snapshot_registry* registry) {
+    atomic_init(&(registry->head), NULL);
+    registry->id = atomic_fetch_add_explicit(&next_id, 1, memory_order_relaxed) + 1;
+}
+
+void snapshot_registry_cleanup(struct snapshot_registry* registry) {
+    struct snapshot_record* record = atomic_load_explicit(&(registry->head), memory_order_relaxed);
+    while (record) {
+        struct snapshot_record* next = record->next;
+        free(record);
+        record = next;
+    }
+}
+
+/** Claim a free record of the given registry, announcing the given snapshot.
+ * @param registry Registry to claim from
+ * @param snapshot Snapshot to announce
+ * @return Claimed record, NULL on allocation failure
+**/
+static struct snapshot_record* snapshot_claim(struct snapshot_registry* registry, uint64_t snapshot) {
+    uint64_t idle = SNAPSHOT_IDLE;
+    if (hint.registry == registry->id && atomic_compare_exchange_strong(&(hint.record->snapshot), &idle, snapshot))
+        return hint.record;
+    struct snapshot_record* record = atomic_load_explicit(&(registry->head), memory_order_acquire);
+    for (; record; record = record->next) {
+        idle = SNAPSHOT_IDLE;
+        if (atomic_compare_exchange_strong(&(record->snapshot), &idle, snapshot))
+            break;
+    }
+    if (!record) { // Every record is in use, add one
+        if (unlikely(posix_memalign((void**) &record, 64, sizeof(struct snapshot_record)) != 0))
+            return NULL;
+        atomic_init(&(record->snapshot), snapshot);
+        record->next = atomic_load_explicit(&(registry->head), memory_order_relaxed);
+        while (unlikely(!atomic_compare_exchange_weak_explicit(&(registry->head), &(record->next), record, memory_order_seq_cst, memory_order_relaxed)));
+    }
+    hint.registry = registry->id;
+    hint.record   = record;
+    return record;
+}
+
+struct snapshot_record* snapshot_acquire(struct snapshot_registry* registry, _Atomic(uint64_t)* clock, uint64_t* snapshot) {
+    uint64_t value = atomic_load(clock);
+    struct snapshot_record* record = snapshot_claim(registry, value);
+    if (unlikely(!record))
+        return NULL;
+    // Note: The snapshot is only used once the clock is seen unchanged after
+    // it was announced (both sequentially consistent): any concurrent scan
+    // either sees the announcement, or read the clock no later than it.
+    while (true) {
+        uint64_t now = atomic_load(clock);
+        if (now == value)
+            break;
+        value = now;
+        atomic_store(&(record->snapshot), value);
+    }
+    *snapshot = value;
+    return record;
+}
+
+void snapshot_release(struct snapshot_record* record) {
+    atomic_store_explicit(&(record->snapshot), SNAPSHOT_IDLE, memory_order_release);
+}
+
+uint64_t snapshot_oldest(struct snapshot_registry* registry, _Atomic(uint64_t)* clock) {
+    uint64_t oldest = atomic_load(clock);
+    for (struct snapshot_record* record = atomic_load(&(registry->head)); record; record = record->next) {
+        uint64_t snapshot = atomic_load(&(record->snapshot));
+        if (snapshot < oldest)
+            oldest = snapshot;
+    }
+    return oldest;
+}
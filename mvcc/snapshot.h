@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Value of a record announcing no snapshot.
+**/
+#define SNAPSHOT_IDLE UINT64_MAX
+
+/**
+ * @brief Announcement of the snapshot of one running transaction, alone in
+ * its cache line. Records are reused by later transactions, and only freed
+ * with their registry.
+ */
+struct snapshot_record {
+    _Alignas(64) _Atomic(uint64_t) snapshot; // Announced snapshot, 'SNAPSHOT_IDLE' if the record is free
+    struct snapshot_record* next; // Next record of the registry
+};
+
+/**
+ * @brief Registry of the snapshots of the running transactions, telling which
+ * versions no running transaction can read anymore.
+ */
+struct snapshot_registry {
+    _Atomic(struct snapshot_record*) head; // Last allocated record
+    uint64_t id; // Unique identifier of the registry, naming it in the per-thread hints
+};
+
+/** Initialize the given registry.
+ * @param registry Registry to initialize
+**/
+void snapshot_registry_init(struct snapshot_registry* registry);
+
+/** Clean the given registry up, while no transaction is running.
+ * @param registry Registry to clean up
+**/
+void snapshot_registry_cleanup(struct snapshot_registry* registry);
+
+/** [thread-safe] Take a snapshot of the given clock and announce it.
+ * @param registry Registry to announce in
+ * @param clock    Clock to take the snapshot of
+ * @param snapshot Taken snapshot (output)
+ * @return Record announcing the snapshot, NULL on allocation failure
+**/
+struct snapshot_record* snapshot_acquire(struct snapshot_registry* registry, _Atomic(uint64_t)* clock, uint64_t* snapshot);
+
+/** [thread-safe] Withdraw the snapshot announced by the given record.
+ * @param record Record to release
+**/
+void snapshot_release(struct snapshot_record* record);
+
+/** [thread-safe] Get the oldest snapshot that a running or future transaction may read at.
+ * @param registry Registry to scan
+ * @param clock    Clock the snapshots are taken of
+ * @return Oldest announced snapshot, or the clock if older
+**/
+uint64_t snapshot_oldest(struct snapshot_registry* registry, _Atomic(uint64_t)* clock);
@@ -0,0 +1,628 @@
+/**
+ * @file   tm.c
+ * @author [...]
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Multi-version transaction manager. Every word holds a chain of its
+ * committed versions, newest first, each tagged with its commit timestamp.
+ * Read-write transactions run in the style of TL2 over the newest versions and
+ * publish new versions at commit time; read-only transactions read, in each
+ * chain, the newest version no younger than their snapshot, and never abort.
+ * Versions older than the oldest announced snapshot are pruned at commit time,
+ * then released in bulk by the epoch-based reclamation, as freed segments are.
+**/
+
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+#ifdef __STDC_NO_ATOMICS__
+    #error Current C11 compiler does not support atomic operations
+#endif
+
+// External headers
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Internal headers
+#include <tm.h>
+
+#include "macros.h"
+#include "epoch.h"
+#include "snapshot.h"
+#include "tx-pool.h"
+#include "write-index.h"
+
+/** Number of pauses spent spinning on a word locked by a committing transaction before yielding.
+**/
+#define WORD_SPIN_COUNT 64
+
+/**
+ * @brief Committed version of a word, immutable once published.
+ */
+struct version {
+    uint64_t ts; // Commit timestamp
+    _Atomic(struct version*) older; // Previous version, NULL if pruned (or if the word was zero before)
+    char data[]; // Value of the word ('align' bytes)
+};
+
+/** Head of the version chain of a word, stored in the first bytes of the word
+ *  itself: when free, the address of the newest version (NULL for the initial
+ *  zero value, at timestamp 0); when locked by a committing transaction, the
+ *  address of the transaction with the lowest bit set.
+**/
+typedef _Atomic(uintptr_t) word_t;
+
+/**
+ * @brief Dynamically allocated segment, the segment data follows the header.
+ */
+struct segment_node {
+    struct segment_node* prev;
+    struct segment_node* next;
+    size_t size; // Size of the segment (in bytes)
+    // uint8_t segment[] // segment of dynamic size, starting at 'header' bytes from the node
+};
+
+/**
+ * @brief Shared memory region, i.e. transactional memory.
+ */
+struct region {
+    _Alignas(64) _Atomic(uint64_t) clock; // Global version clock, alone in its cache line
+    _Alignas(64) struct snapshot_registry snapshots; // Snapshots of the running transactions
+    struct segment_node* start; // Non-deallocable memory segment
+    size_t size;   // Size of the non-deallocable memory segment (in bytes)
+    size_t align;  // Size of a word in the shared memory region (in bytes)
+    size_t header; // Size of the header preceding each segment (in bytes)
+    pthread_mutex_t allocs_lock; // Lock protecting 'allocs'
+    struct segment_node* allocs; // Segments dynamically allocated by committed transactions, and not freed yet
+    struct ebr ebr; // Reclamation of the pruned versions and freed segments
+};
+
+/**
+ * @brief Grow-on-demand array of fixed-size elements.
+ */
+struct vector {
+    void*  data; // Elements
+    size_t size; // Number of elements in use
+    size_t cap;  // Number of allocated elements
+};
+
+/** Append one (uninitialized) element to the given vector.
+ * @param vec  Vector to append to
+ * @param elem Size of one element (in bytes)
+ * @return Address of the appended element, NULL on allocation failure
+**/
+static void* vector_push(struct vector* vec, size_t elem) {
+    if (unlikely(vec->size == vec->cap)) {
+        size_t cap = vec->cap == 0 ? 16 : 2 * vec->cap;
+        void* data = realloc(vec->data, cap * elem);
+        if (unlikely(!data))
+            return NULL;
+        vec->data = data;
+        vec->cap  = cap;
+    }
+    return (char*) vec->data + elem * vec->size++;
+}
+
+/**
+ * @brief Word read by a read-write transaction, with the version it read.
+ */
+struct read_entry {
+    word_t*   word;
+    uintptr_t seen;
+};
+
+/**
+ * @brief Word written by a read-write transaction, with its new version and,
+ * once locked at commit time, its value before locking.
+ */
+struct write_entry {
+    word_t*         word;
+    struct version* version;
+    uintptr_t       prev;
+};
+
+/**
+ * @brief Transaction descriptor, recycled through the pool of the thread that ran it.
+ */
+struct tx {
+    struct tx_pool_link link; // Link in the pool of recycled descriptors
+    bool     is_ro;  // Whether the transaction is read-only
+    uint64_t rv;     // Snapshot, i.e. value of the global clock at begin
+    struct snapshot_record* record; // Announcement of the snapshot
+    size_t   locked; // Number of written words locked at commit time, in write order
+    struct vector reads;  // Words read (struct read_entry)
+    struct vector writes; // Words written, in order of first write (struct write_entry)
+    struct write_index index; // Position of each written word in 'writes'
+    struct vector allocs; // Segments allocated by this transaction (struct segment_node*)
+    struct vector frees;  // Segments freed by this transaction (struct segment_node*)
+    struct ebr_record* ebr; // Critical section of the transaction
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Tell whether the given head of a version chain is locked.
+ * @param value Head of a version chain
+ * @return Whether the head is locked
+**/
+static inline bool word_is_locked(uintptr_t value) {
+    return value & 1;
+}
+
+/** Get the head of a version chain locked by the given transaction.
+ * @param tx Locking transaction
+ * @return Locked head
+**/
+static inline uintptr_t word_owned_by(struct tx const* tx) {
+    return (uintptr_t) tx | 1;
+}
+
+/** Free the versions of the given chain.
+ * @param version Newest version to free
+**/
+static void version_free_chain(struct version* version) {
+    while (version) {
+        struct version* older = atomic_load_explicit(&(version->older), memory_order_relaxed);
+        free(version);
+        version = older;
+    }
+}
+
+/** Release a pruned chain of versions.
+ * @param arg     Unused
+ * @param version Newest version of the chain
+**/
+static void version_release_chain(void* unused(arg), void* version) {
+    version_free_chain((struct version*) version);
+}
+
+/** Retire the versions of the given chain that no transaction can read anymore,
+ *  i.e. those older than the newest version no younger than the oldest snapshot.
+ * @param record  Critical section of the pruning transaction
+ * @param version Newest version of the chain, whose word is locked by the caller
+ * @param oldest  Oldest snapshot a running or future transaction may read at
+**/
+static void version_prune(struct ebr_record* record, struct version* version, uint64_t oldest) {
+    while (version && version->ts > oldest)
+        version = atomic_load_explicit(&(version->older), memory_order_relaxed);
+    if (!version)
+        return;
+    struct version* older = atomic_load_explicit(&(version->older), memory_order_relaxed);
+    if (!older)
+        return;
+    atomic_store_explicit(&(version->older), NULL, memory_order_relaxed);
+    ebr_retire(record, older, version_release_chain, NULL);
+}
+
+/** Free the version chains of the words of the given segment.
+ * @param region  Region the segment belongs to
+ * @param segment First byte of the segment
+ * @param size    Size of the segment (in bytes)
+**/
+static void segment_free_versions(struct region const* region, char* segment, size_t size) {
+    for (size_t offset = 0; offset < size; offset += region->align)
+        version_free_chain((struct version*) atomic_load_explicit((word_t*) (segment + offset), memory_order_relaxed));
+}
+
+/** Release a freed segment and its version chains, once no transaction can access it anymore.
+ * @param arg Region the segment belonged to
+ * @param sn  Segment to release
+**/
+static void segment_release(void* arg, void* sn) {
+    struct region const* region = (struct region const*) arg;
+    segment_free_versions(region, (char*) sn + region->header, ((struct segment_node*) sn)->size);
+    free(sn);
+}
+
+/** Free the given pooled descriptor.
+ * @param link Link of the descriptor to free
+**/
+static void tx_free(struct tx_pool_link* link) {
+    struct tx* tx = (struct tx*) link;
+    free(tx->reads.data);
+    free(tx->writes.data);
+    free(tx->allocs.data);
+    free(tx->frees.data);
+    write_index_cleanup(&(tx->index));
+    free(tx);
+}
+
+/** Withdraw the snapshot of the given (ended) transaction, leave its critical section, reset it and give it back to the pool of the calling thread.
+ * @param region Region the transaction ran on
+ * @param tx     Transaction to release
+**/
+static void tx_release(struct region* region, struct tx* tx) {
+    snapshot_release(tx->record);
+    ebr_leave(&(region->ebr), tx->ebr);
+    tx->locked      = 0;
+    tx->reads.size  = 0;
+    tx->writes.size = 0;
+    tx->allocs.size = 0;
+    tx->frees.size  = 0;
+    write_index_reset(&(tx->index));
+    tx_pool_give(&(tx->link), tx_free);
+}
+
+/** Abort the given transaction: release the taken locks, the unpublished versions and the segments it allocated.
+ * @param region Region the transaction ran on
+ * @param tx     Transaction to abort
+**/
+static void tx_abort(struct region* region, struct tx* tx) {
+    struct write_entry* writes = (struct write_entry*) tx->writes.data;
+    for (size_t i = 0; i < tx->locked; ++i)
+        atomic_store_explicit(writes[i].word, writes[i].prev, memory_order_release);
+    for (size_t i = 0; i < tx->writes.size; ++i)
+        free(writes[i].version);
+    struct segment_node** allocs = (struct segment_node**) tx->allocs.data;
+    for (size_t i = 0; i < tx->allocs.size; ++i)
+        free(allocs[i]);
+    tx_release(region, tx);
+}
+
+/** Find the given word in the write set.
+ * @param tx   Transaction to query
+ * @param word Word in shared memory
+ * @return Entry of the word, NULL if the word was not written
+**/
+static struct write_entry* tx_find_write(struct tx const* tx, word_t const* word) {
+    size_t entry = write_index_find(&(tx->index), word);
+    return entry == WRITE_INDEX_NONE ? NULL : (struct write_entry*) tx->writes.data + entry;
+}
+
+/** Make the segments allocated by the given (committed) transaction part of the region.
+ * @param region Region to insert the segments into
+ * @param tx     Committed transaction
+**/
+static void tx_publish_allocs(struct region* region, struct tx const* tx) {
+    if (tx->allocs.size == 0)
+        return;
+    struct segment_node** allocs = (struct segment_node**) tx->allocs.data;
+    pthread_mutex_lock(&(region->allocs_lock));
+    for (size_t i = 0; i < tx->allocs.size; ++i) {
+        struct segment_node* sn = allocs[i];
+        sn->prev = NULL;
+        sn->next = region->allocs;
+        if (sn->next)
+            sn->next->prev = sn;
+        region->allocs = sn;
+    }
+    pthread_mutex_unlock(&(region->allocs_lock));
+}
+
+/** Remove the segments freed by the given (committed) transaction from the region, and retire them.
+ * @param region Region to remove the segments from
+ * @param tx     Committed transaction
+**/
+static void tx_retire_frees(struct region* region, struct tx const* tx) {
+    if (tx->frees.size == 0)
+        return;
+    struct segment_node** frees = (struct segment_node**) tx->frees.data;
+    pthread_mutex_lock(&(region->allocs_lock));
+    for (size_t i = 0; i < tx->frees.size; ++i) {
+        struct segment_node* sn = frees[i];
+        if (sn->prev) {
+            sn->prev->next = sn->next;
+        } else {
+            region->allocs = sn->next;
+        }
+        if (sn->next)
+            sn->next->prev = sn->prev;
+    }
+    pthread_mutex_unlock(&(region->allocs_lock));
+    for (size_t i = 0; i < tx->frees.size; ++i)
+        ebr_retire(tx->ebr, frees[i], segment_release, region);
+}
+
+/** Check that the given read word still holds the version the transaction read.
+ * @param tx   Transaction to validate
+ * @param read Entry of the read word
+ * @return Whether the word is still consistent with the snapshot
+**/
+static bool tx_validate_read(struct tx const* tx, struct read_entry const* read) {
+    uintptr_t value = atomic_load_explicit(read->word, memory_order_acquire);
+    if (value == word_owned_by(tx)) // Locked by ourself at commit time, check the version before locking
+        return tx_find_write(tx, read->word)->prev == read->seen;
+    return value == read->seen;
+}
+
+/** Try to commit the given read-write transaction.
+ * @param region Region the transaction runs on
+ * @param tx     Transaction to commit
+ * @return Whether the transaction committed
+**/
+static bool tx_commit(struct region* region, struct tx* tx) {
+    struct write_entry* writes = (struct write_entry*) tx->writes.data;
+    size_t const nbwrites = tx->writes.size;
+    if (nbwrites == 0) { // Nothing to publish: the reads were consistent with 'rv'
+        tx_publish_allocs(region, tx);
+        tx_retire_frees(region, tx);
+        return true;
+    }
+    // Lock the written words
+    for (; tx->locked < nbwrites; ++tx->locked) {
+        struct write_entry* write = writes + tx->locked;
+        uintptr_t value = atomic_load_explicit(write->word, memory_order_relaxed);
+        if (word_is_locked(value) || !atomic_compare_exchange_strong_explicit(write->word, &value, word_owned_by(tx), memory_order_acquire, memory_order_relaxed))
+            return false;
+        write->prev = value;
+    }
+    // Get the write version, and validate the read set if another transaction committed in between
+    uint64_t wv = atomic_fetch_add_explicit(&(region->clock), 1, memory_order_acq_rel) + 1;
+    if (wv != tx->rv + 1) {
+        struct read_entry const* reads = (struct read_entry const*) tx->reads.data;
+        for (size_t i = 0; i < tx->reads.size; ++i) {
+            if (!tx_validate_read(tx, reads + i))
+                return false;
+        }
+    }
+    // Publish the new versions, pruning the chains, then release the locks
+    uint64_t oldest = snapshot_oldest(&(region->snapshots), &(region->clock));
+    for (size_t i = 0; i < nbwrites; ++i) {
+        struct version* version = writes[i].version;
+        version->ts = wv;
+        atomic_store_explicit(&(version->older), (struct version*) writes[i].prev, memory_order_relaxed);
+        version_prune(tx->ebr, version, oldest);
+        atomic_store_explicit(writes[i].word, (uintptr_t) version, memory_order_release);
+    }
+    tx->locked = 0;
+    tx_publish_allocs(region, tx);
+    tx_retire_frees(region, tx);
+    return true;
+}
+
+/** Read the given word at the snapshot of the given read-only transaction.
+ * @param region Region the word belongs to
+ * @param tx     Reading transaction
+ * @param word   Word to read
+ * @param target Target address (in a private region)
+**/
+static void word_read_snapshot(struct region const* region, struct tx const* tx, word_t* word, void* target) {
+    // Note: A transaction that committed at or before the snapshot locked its
+    // words before taking its write version, so the word is either seen locked
+    // or seen with that version published. A locked word is waited for: its
+    // pending version may be part of the snapshot.
+    uintptr_t value;
+    size_t spins = 0;
+    while (word_is_locked(value = atomic_load_explicit(word, memory_order_acquire))) {
+        if (spins < WORD_SPIN_COUNT) {
+            ++spins;
+#if defined(__i386__) || defined(__x86_64__)
+            _mm_pause();
+#endif
+        } else {
+            sched_yield();
+        }
+    }
+    struct version const* version = (struct version const*) value;
+    while (version && version->ts > tx->rv)
+        version = atomic_load_explicit(&(version->older), memory_order_acquire);
+    if (version) {
+        memcpy(target, version->data, region->align);
+    } else {
+        memset(target, 0, region->align);
+    }
+}
+
+/** Read the newest version of the given word in the given read-write transaction.
+ * @param region Region the word belongs to
+ * @param tx     Reading transaction
+ * @param word   Word to read
+ * @param target Target address (in a private region)
+ * @return Whether the transaction can continue
+**/
+static bool word_read_newest(struct region const* region, struct tx* tx, word_t* word, void* target) {
+    uintptr_t value = atomic_load_explicit(word, memory_order_acquire);
+    struct version const* version = (struct version const*) value;
+    if (word_is_locked(value) || (version && version->ts > tx->rv))
+        return false;
+    struct read_entry* entry = (struct read_entry*) vector_push(&(tx->reads), sizeof(struct read_entry));
+    if (unlikely(!entry))
+        return false;
+    entry->word = word;
+    entry->seen = value;
+    if (version) {
+        memcpy(target, version->data, region->align);
+    } else {
+        memset(target, 0, region->align);
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+// Note: The head of the version chain of a word lives in the word itself, so
+// words must be large enough to hold a pointer.
+shared_t tm_create(size_t size, size_t align) {
+    if (unlikely(align < sizeof(word_t)))
+        return invalid_shared;
+    struct region* region;
+    if (unlikely(posix_memalign((void**) &region, 64, sizeof(struct region)) != 0))
+        return invalid_shared;
+    region->header = (sizeof(struct segment_node) + align - 1) / align * align;
+    if (unlikely(posix_memalign((void**) &(region->start), align, region->header + size) != 0)) {
+        free(region);
+        return invalid_shared;
+    }
+    if (unlikely(pthread_mutex_init(&(region->allocs_lock), NULL) != 0)) {
+        free(region->start);
+        free(region);
+        return invalid_shared;
+    }
+    region->start->size = size;
+    memset((char*) region->start + region->header, 0, size);
+    atomic_init(&(region->clock), 0);
+    region->allocs = NULL;
+    snapshot_registry_init(&(region->snapshots));
+    ebr_init(&(region->ebr));
+    region->size  = size;
+    region->align = align;
+    return region;
+}
+
+void tm_destroy(shared_t shared) {
+    struct region* region = (struct region*) shared;
+    struct segment_node* sn = region->allocs;
+    while (sn) { // Free allocated segments
+        struct segment_node* tail = sn->next;
+        segment_free_versions(region, (char*) sn + region->header, sn->size);
+        free(sn);
+        sn = tail;
+    }
+    segment_free_versions(region, (char*) region->start + region->header, region->size);
+    ebr_cleanup(&(region->ebr)); // Free retired versions and segments
+    pthread_mutex_destroy(&(region->allocs_lock));
+    snapshot_registry_cleanup(&(region->snapshots));
+    free(region->start);
+    free(region);
+}
+
+void* tm_start(shared_t shared) {
+    struct region* region = (struct region*) shared;
+    return (char*) region->start + region->header;
+}
+
+size_t tm_size(shared_t shared) {
+    return ((struct region*) shared)->size;
+}
+
+size_t tm_align(shared_t shared) {
+    return ((struct region*) shared)->align;
+}
+
+tx_t tm_begin(shared_t shared, bool is_ro) {
+    struct region* region = (struct region*) shared;
+    struct tx* tx = (struct tx*) tx_pool_take(); // Descriptors, and their logs, are reused across the transactions (and retries) of the thread
+    if (!tx)
+        tx = (struct tx*) calloc(1, sizeof(struct tx));
+    if (unlikely(!tx))
+        return invalid_tx;
+    tx->ebr = ebr_enter(&(region->ebr));
+    if (unlikely(!tx->ebr)) {
+        tx_free(&(tx->link));
+        return invalid_tx;
+    }
+    tx->record = snapshot_acquire(&(region->snapshots), &(region->clock), &(tx->rv));
+    if (unlikely(!tx->record)) {
+        ebr_leave(&(region->ebr), tx->ebr);
+        tx_free(&(tx->link));
+        return invalid_tx;
+    }
+    tx->is_ro = is_ro;
+    return (tx_t) tx;
+}
+
+bool tm_end(shared_t shared, tx_t tx) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    if (t->is_ro) { // Every read was at the snapshot
+        tx_release(region, t);
+        return true;
+    }
+    if (unlikely(!tx_commit(region, t))) {
+        tx_abort(region, t);
+        return false;
+    }
+    tx_release(region, t);
+    return true;
+}
+
+bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    size_t const align = region->align;
+    for (size_t offset = 0; offset < size; offset += align) {
+        word_t* word = (word_t*) ((char*) source + offset);
+        void* dest = (char*) target + offset;
+        if (t->is_ro) {
+            word_read_snapshot(region, t, word, dest);
+            continue;
+        }
+        struct write_entry const* write = tx_find_write(t, word);
+        if (write) { // Read-after-write
+            memcpy(dest, write->version->data, align);
+        } else if (!word_read_newest(region, t, word, dest)) {
+            tx_abort(region, t);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    size_t const align = region->align;
+    for (size_t offset = 0; offset < size; offset += align) {
+        word_t* word = (word_t*) ((char*) target + offset);
+        struct write_entry* write = tx_find_write(t, word);
+        if (!write) {
+            struct version* version = (struct version*) malloc(sizeof(struct version) + align);
+            if (unlikely(!version))
+                goto abort;
+            write = (struct write_entry*) vector_push(&(t->writes), sizeof(struct write_entry));
+            if (unlikely(!write)) {
+                free(version);
+                goto abort;
+            }
+            write->word    = word;
+            write->version = version;
+            if (unlikely(!write_index_insert(&(t->index), word, t->writes.size - 1))) {
+                --t->writes.size;
+                free(version);
+                goto abort;
+            }
+        }
+        memcpy(write->version->data, (char const*) source + offset, align);
+    }
+    return true;
+abort:
+    tx_abort(region, t);
+    return false;
+}
+
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    struct segment_node* sn;
+    if (unlikely(posix_memalign((void**) &sn, region->align, region->header + size) != 0))
+        return nomem_alloc;
+    struct segment_node** entry = (struct segment_node**) vector_push(&(t->allocs), sizeof(struct segment_node*));
+    if (unlikely(!entry)) {
+        free(sn);
+        return nomem_alloc;
+    }
+    *entry = sn;
+    sn->size = size;
+    void* segment = (void*) ((uintptr_t) sn + region->header);
+    memset(segment, 0, size); // Every word starts with an empty version chain
+    *target = segment;
+    return success_alloc;
+}
+
+// Note: Running transactions may still be reading a segment that a committed
+// transaction freed. Hence a freed segment is retired at commit time, and only
+// released, with its version chains, once every transaction running at that
+// time has ended.
+bool tm_free(shared_t shared, tx_t tx, void* segment) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    struct segment_node** entry = (struct segment_node**) vector_push(&(t->frees), sizeof(struct segment_node*));
+    if (unlikely(!entry)) {
+        tx_abort(region, t);
+        return false;
+    }
+    *entry = (struct segment_node*) ((uintptr_t) segment - region->header);
+    return true;
+}
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "write-index.h"
+
+/** Number of slots of a table on first insertion (power of 2).
+**/
+#define WRITE_INDEX_MIN_SLOTS 64
+
+/** Insert a word that is not indexed yet, in a table with a free slot.
+ * @param index Index to insert into
+ * @param word  Address of the word
+ * @param entry Index of the word in the write set
+**/
+static void write_index_place(struct write_index* index, void const* word, uint32_t entry) {
+    size_t i = write_index_hash(word) >> index->shift;
+    while (index->slots[i].stamp == index->stamp)
+        i = (i + 1) & index->mask;
+    index->slots[i] = (struct write_index_slot) { word, entry, index->stamp };
+}
+
+/** Double the number of slots of the given index (or allocate the first ones).
+ * @param index Index to grow
+ * @return Whether the operation is a success
+**/
+static bool write_index_grow(struct write_index* index) {
+    size_t nb = index->slots ? 2 * (index->mask + 1) : WRITE_INDEX_MIN_SLOTS;
+    struct write_index_slot* slots = (struct write_index_slot*) malloc(nb * sizeof(struct write_index_slot));
+    if (unlikely(!slots))
+        return false;
+    struct write_index old = *index;
+    index->slots = slots;
+    index->mask  = nb - 1;
+    index->shift = 64;
+    for (size_t i = nb; i > 1; i >>= 1)
+        --index->shift;
+    index->stamp = 1; // Fresh table: zeroed slots are empty
+    memset(slots, 0, nb * sizeof(struct write_index_slot));
+    for (size_t i = 0; old.slots && i <= old.mask; ++i) {
+        if (old.slots[i].stamp == old.stamp)
+            write_index_place(index, old.slots[i].word, old.slots[i].entry);
+    }
+    free(old.slots);
+    return true;
+}
+
+void write_index_cleanup(struct write_index* index) {
+    free(index->slots);
+}
+
+void write_index_reset(struct write_index* index) {
+    index->bloom = 0;
+    index->size  = 0;
+    if (unlikely(++index->stamp == 0)) { // Stamps wrapped around, empty the slots for real
+        if (index->slots)
+            memset(index->slots, 0, (index->mask + 1) * sizeof(struct write_index_slot));
+        index->stamp = 1;
+    }
+}
+
+bool write_index_insert(struct write_index* index, void const* word, size_t entry) {
+    if (unlikely(!index->slots || 2 * (index->size + 1) > index->mask + 1)) { // Keep the load factor at most one half
+        if (unlikely(!write_index_grow(index)))
+            return false;
+    }
+    write_index_place(index, word, (uint32_t) entry);
+    index->bloom |= write_index_bloom(write_index_hash(word));
+    ++index->size;
+    return true;
+}
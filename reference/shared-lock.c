@@ -1,5 +1,199 @@
 #include "shared-lock.h"
 
+#if defined(SHARED_LOCK_SPIN) || defined(SHARED_LOCK_DISTRIBUTED)
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/** Pause execution for a "short" period of time.
+**/
+static inline void short_pause(void) {
+#if defined(__i386__) || defined(__x86_64__)
+    _mm_pause();
+#endif
+}
+
+/** Park on the given word, as long as it holds the given value.
+ * @param word     Word to park on
+ * @param value    Observed value of the word
+ * @param sleepers Number of threads parked on the word
+**/
+static void futex_park(_Atomic(uint32_t)* word, uint32_t value, _Atomic(uint32_t)* sleepers) {
+    atomic_fetch_add(sleepers, 1);
+    // Note: Wakers change the word before reading 'sleepers' (both sequentially
+    // consistent), so either they see this sleeper or the wait returns at once.
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+    atomic_fetch_sub(sleepers, 1);
+}
+
+/** Wake up every thread parked on the given (changed) word, if any.
+ * @param word     Word that changed
+ * @param sleepers Number of threads parked on the word
+**/
+static void futex_wake(_Atomic(uint32_t)* word, _Atomic(uint32_t)* sleepers) {
+    if (atomic_load(sleepers) > 0)
+        syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+#endif
+
+#if defined(SHARED_LOCK_DISTRIBUTED)
+
+static _Atomic(size_t) next_slot = 0; // Slot to assign to the next thread
+static _Thread_local size_t thread_slot = SIZE_MAX; // Slot of the calling thread, SIZE_MAX if unassigned
+
+/** Get the reader counter of the calling thread in the given lock.
+ * @param lock Lock to query
+ * @return Reader counter of the calling thread
+**/
+static inline _Atomic(uint32_t)* shared_lock_readers(struct shared_lock_t* lock) {
+    if (thread_slot == SIZE_MAX)
+        thread_slot = atomic_fetch_add_explicit(&next_slot, 1, memory_order_relaxed) % SHARED_LOCK_SLOTS;
+    return &(lock->slots[thread_slot].readers);
+}
+
+bool shared_lock_init(struct shared_lock_t* lock) {
+    for (size_t i = 0; i < SHARED_LOCK_SLOTS; ++i)
+        atomic_init(&(lock->slots[i].readers), 0);
+    atomic_init(&(lock->writer), 0);
+    atomic_init(&(lock->sleepers), 0);
+    return true;
+}
+
+void shared_lock_cleanup(struct shared_lock_t* lock) {
+    (void) lock;
+}
+
+bool shared_lock_acquire(struct shared_lock_t* lock) {
+    size_t spins = 0;
+    while (true) {
+        uint32_t writer = 0;
+        if (atomic_compare_exchange_weak(&(lock->writer), &writer, 1))
+            break;
+        if (writer == 0)
+            continue;
+        if (spins < SHARED_LOCK_SPIN_COUNT) {
+            ++spins;
+            short_pause();
+        } else {
+            futex_park(&(lock->writer), writer, &(lock->sleepers));
+        }
+    }
+    // Note: Readers increment their counter before checking 'writer' (both
+    // sequentially consistent), so any reader missed by this scan backs off.
+    // Readers hold the lock briefly, so they are waited for without parking.
+    for (size_t i = 0; i < SHARED_LOCK_SLOTS; ++i) {
+        spins = 0;
+        while (atomic_load(&(lock->slots[i].readers)) != 0) {
+            if (spins < SHARED_LOCK_SPIN_COUNT) {
+                ++spins;
+                short_pause();
+            } else {
+                sched_yield();
+            }
+        }
+    }
+    return true;
+}
+
+void shared_lock_release(struct shared_lock_t* lock) {
+    atomic_store(&(lock->writer), 0);
+    futex_wake(&(lock->writer), &(lock->sleepers));
+}
+
+bool shared_lock_acquire_shared(struct shared_lock_t* lock) {
+    _Atomic(uint32_t)* readers = shared_lock_readers(lock);
+    while (true) {
+        atomic_fetch_add(readers, 1);
+        if (atomic_load(&(lock->writer)) == 0)
+            return true;
+        atomic_fetch_sub_explicit(readers, 1, memory_order_release); // Back off, letting the writer drain the readers
+        size_t spins = 0;
+        uint32_t writer;
+        while ((writer = atomic_load_explicit(&(lock->writer), memory_order_relaxed)) != 0) {
+            if (spins < SHARED_LOCK_SPIN_COUNT) {
+                ++spins;
+                short_pause();
+            } else {
+                futex_park(&(lock->writer), writer, &(lock->sleepers));
+            }
+        }
+    }
+}
+
+void shared_lock_release_shared(struct shared_lock_t* lock) {
+    atomic_fetch_sub_explicit(shared_lock_readers(lock), 1, memory_order_release);
+}
+
+#elif defined(SHARED_LOCK_SPIN)
+
+static const uint32_t shared_lock_writer = (uint32_t) 1 << 31;
+
+bool shared_lock_init(struct shared_lock_t* lock) {
+    atomic_init(&(lock->state), 0);
+    atomic_init(&(lock->writers), 0);
+    atomic_init(&(lock->sleepers), 0);
+    return true;
+}
+
+void shared_lock_cleanup(struct shared_lock_t* lock) {
+    (void) lock;
+}
+
+bool shared_lock_acquire(struct shared_lock_t* lock) {
+    atomic_fetch_add(&(lock->writers), 1);
+    size_t spins = 0;
+    while (true) {
+        uint32_t state = atomic_load_explicit(&(lock->state), memory_order_relaxed);
+        if (state == 0) {
+            if (atomic_compare_exchange_weak_explicit(&(lock->state), &state, shared_lock_writer, memory_order_acquire, memory_order_relaxed))
+                return true;
+        } else if (spins < SHARED_LOCK_SPIN_COUNT) {
+            ++spins;
+            short_pause();
+        } else {
+            futex_park(&(lock->state), state, &(lock->sleepers));
+        }
+    }
+}
+
+void shared_lock_release(struct shared_lock_t* lock) {
+    atomic_fetch_sub_explicit(&(lock->writers), 1, memory_order_relaxed);
+    atomic_store(&(lock->state), 0);
+    futex_wake(&(lock->state), &(lock->sleepers));
+}
+
+bool shared_lock_acquire_shared(struct shared_lock_t* lock) {
+    size_t spins = 0;
+    while (true) {
+        uint32_t state = atomic_load_explicit(&(lock->state), memory_order_relaxed);
+        if (!(state & shared_lock_writer) && !(SHARED_LOCK_WRITER_PREFERENCE && atomic_load_explicit(&(lock->writers), memory_order_relaxed) > 0)) {
+            if (atomic_compare_exchange_weak_explicit(&(lock->state), &state, state + 1, memory_order_acquire, memory_order_relaxed))
+                return true;
+        } else if (spins < SHARED_LOCK_SPIN_COUNT) {
+            ++spins;
+            short_pause();
+        } else if (state == 0) { // A writer is about to take the lock, and no later change of the state may wake this reader
+            sched_yield();
+        } else {
+            futex_park(&(lock->state), state, &(lock->sleepers));
+        }
+    }
+}
+
+void shared_lock_release_shared(struct shared_lock_t* lock) {
+    if (atomic_fetch_sub(&(lock->state), 1) == 1) // Last reader, writers may be parked
+        futex_wake(&(lock->state), &(lock->sleepers));
+}
+
+#else
+
 bool shared_lock_init(struct shared_lock_t* lock) {
     return pthread_rwlock_init(&lock->rwlock, NULL) == 0;
 }
@@ -23,3 +217,5 @@ bool shared_lock_acquire_shared(struct shared_lock_t* lock) {
 void shared_lock_release_shared(struct shared_lock_t* lock) {
     pthread_rwlock_unlock(&lock->rwlock);
 }
+
+#endif
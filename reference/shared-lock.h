@@ -11,6 +11,69 @@
 #include <pthread.h>
 #include <stdbool.h>
 
+// Note: Defining 'SHARED_LOCK_SPIN' at build time (e.g. 'make clean build
+// DEFINES=SHARED_LOCK_SPIN') replaces the pthread read-write lock with a
+// single atomic word, spun on then parked on with futexes. Defining
+// 'SHARED_LOCK_DISTRIBUTED' instead spreads the readers over per-thread-slot
+// counters, so that shared acquisitions do not contend on one cache line.
+#if defined(SHARED_LOCK_SPIN) || defined(SHARED_LOCK_DISTRIBUTED)
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/** Number of pauses spent spinning on a taken lock before parking.
+**/
+#ifndef SHARED_LOCK_SPIN_COUNT
+#define SHARED_LOCK_SPIN_COUNT 128
+#endif
+
+#endif
+
+#if defined(SHARED_LOCK_DISTRIBUTED)
+
+/** Number of reader counters, threads being assigned one in round-robin.
+**/
+#ifndef SHARED_LOCK_SLOTS
+#define SHARED_LOCK_SLOTS 64
+#endif
+
+/**
+ * @brief Reader counter of a shared lock, alone in its cache line.
+ */
+struct shared_lock_slot {
+    _Alignas(64) _Atomic(uint32_t) readers; // Number of readers of the slot holding the lock
+};
+
+/**
+ * @brief A lock that can be taken exclusively but also shared. Contrarily to
+ * exclusive locks, shared locks do not have wait/wake_up capabilities.
+ */
+struct shared_lock_t {
+    struct shared_lock_slot slots[SHARED_LOCK_SLOTS]; // Distributed reader indicator, scanned by writers
+    _Alignas(64) _Atomic(uint32_t) writer; // Whether a writer holds (or is draining the readers of) the lock, parked on
+    _Atomic(uint32_t) sleepers; // Number of threads parked on 'writer'
+};
+
+#elif defined(SHARED_LOCK_SPIN)
+
+/** Whether a waiting writer keeps new readers from entering, so that readers cannot starve writers.
+**/
+#ifndef SHARED_LOCK_WRITER_PREFERENCE
+#define SHARED_LOCK_WRITER_PREFERENCE 1
+#endif
+
+/**
+ * @brief A lock that can be taken exclusively but also shared. Contrarily to
+ * exclusive locks, shared locks do not have wait/wake_up capabilities.
+ */
+struct shared_lock_t {
+    _Atomic(uint32_t) state;    // Writer bit (most significant) and number of readers (other bits), parked on
+    _Atomic(uint32_t) writers;  // Number of writers waiting for or holding the lock
+    _Atomic(uint32_t) sleepers; // Number of threads parked on 'state'
+};
+
+#else
+
 /**
  * @brief A lock that can be taken exclusively but also shared. Contrarily to
  * exclusive locks, shared locks do not have wait/wake_up capabilities.
@@ -19,6 +82,8 @@ struct shared_lock_t {
     pthread_rwlock_t rwlock;
 };
 
+#endif
+
 /** Initialize the given lock.
  * @param lock Lock to initialize
  * @return Whether the operation is a success
@@ -61,8 +61,8 @@ struct region {
 };
 
 shared_t tm_create(size_t size, size_t align) {
-    struct region* region = (struct region*) malloc(sizeof(struct region));
-    if (unlikely(!region)) {
+    struct region* region;
+    if (unlikely(posix_memalign((void**) &region, _Alignof(struct region), sizeof(struct region)) != 0)) { // The lock may be over-aligned
         return invalid_shared;
     }
     // We allocate the shared memory buffer such that its words are correctly
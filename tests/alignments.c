@@ -0,0 +1,159 @@
+/**
+ * @file   alignments.c
+ *
+ * @section DESCRIPTION
+ *
+ * Regression test of the transactional libraries given on the command line:
+ * regions of different alignments are created and destroyed in turn on the
+ * same thread, so that recycled transaction descriptors meet word sizes other
+ * than the one they last ran with (alignments a library rejects are skipped).
+ * Each region checks that multi-word writes are read back within the writing
+ * transaction and after its commit. Overflows are only reliably caught with
+ * the libraries built with '-fsanitize=address'.
+**/
+
+// Requested feature: RTLD_NOW
+#define _POSIX_C_SOURCE 200809L
+
+// External headers
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+
+// Internal headers
+#include "../include/tm.h"
+
+/** Number of words written at once, and number of words of each region.
+**/
+#define NB_WORDS    8
+#define REGION_WORDS 64
+
+/** Largest alignment tested (in bytes).
+**/
+#define MAX_ALIGN 32
+
+/**
+ * @brief Functions of a transactional library.
+ */
+struct library {
+    shared_t (*create)(size_t, size_t);
+    void     (*destroy)(shared_t);
+    void*    (*start)(shared_t);
+    tx_t     (*begin)(shared_t, bool);
+    bool     (*end)(shared_t, tx_t);
+    bool     (*read)(shared_t, tx_t, void const*, size_t, void*);
+    bool     (*write)(shared_t, tx_t, void const*, size_t, void*);
+};
+
+/** Load the given library.
+ * @param lib  Library to fill
+ * @param path Path of the shared object
+ * @return Whether the operation is a success
+**/
+static bool library_load(struct library* lib, char const* path) {
+    void* module = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!module) {
+        fprintf(stderr, "%s: %s\n", path, dlerror());
+        return false;
+    }
+    #define LOAD(field, name) \
+        if (!(*(void**) &(lib->field) = dlsym(module, name))) { \
+            fprintf(stderr, "%s: missing symbol '%s'\n", path, name); \
+            return false; \
+        }
+    LOAD(create,  "tm_create")
+    LOAD(destroy, "tm_destroy")
+    LOAD(start,   "tm_start")
+    LOAD(begin,   "tm_begin")
+    LOAD(end,     "tm_end")
+    LOAD(read,    "tm_read")
+    LOAD(write,   "tm_write")
+    #undef LOAD
+    return true;
+}
+
+/** Fill the given buffer with a pattern specific to the given alignment and round.
+ * @param buffer Buffer to fill
+ * @param size   Size of the buffer (in bytes)
+ * @param align  Alignment of the region
+ * @param round  Round number
+**/
+static void pattern(unsigned char* buffer, size_t size, size_t align, unsigned int round) {
+    for (size_t i = 0; i < size; ++i)
+        buffer[i] = (unsigned char) (i * 7 + align * 13 + round * 29 + 1);
+}
+
+/** Run one round on a fresh region of the given alignment, skipped if the library does not support the alignment.
+ * @param lib   Library to test
+ * @param align Alignment of the region
+ * @param round Round number
+ * @return Whether the checks passed
+**/
+static bool round_run(struct library const* lib, size_t align, unsigned int round) {
+    unsigned char expected[NB_WORDS * MAX_ALIGN];
+    unsigned char actual[NB_WORDS * MAX_ALIGN];
+    size_t size = NB_WORDS * align;
+    pattern(expected, size, align, round);
+    shared_t shared = lib->create(REGION_WORDS * align, align);
+    if (shared == invalid_shared) // E.g. word sizes smaller than a pointer
+        return true;
+    void* target = (char*) lib->start(shared) + align; // Not at the start of the buffered words either
+    bool ok = false;
+    while (true) { // Retried on abort, although nothing conflicts on one thread
+        tx_t tx = lib->begin(shared, false);
+        if (tx == invalid_tx)
+            goto destroy;
+        if (!lib->write(shared, tx, expected, size, target))
+            continue;
+        memset(actual, 0, size);
+        if (!lib->read(shared, tx, target, size, actual))
+            continue;
+        if (memcmp(actual, expected, size) != 0) {
+            fprintf(stderr, "align %zu: read-after-write in the writing transaction differs\n", align);
+            lib->end(shared, tx);
+            goto destroy;
+        }
+        if (lib->end(shared, tx))
+            break;
+    }
+    while (true) {
+        tx_t tx = lib->begin(shared, true);
+        if (tx == invalid_tx)
+            goto destroy;
+        memset(actual, 0, size);
+        if (!lib->read(shared, tx, target, size, actual))
+            continue;
+        if (lib->end(shared, tx))
+            break;
+    }
+    ok = memcmp(actual, expected, size) == 0;
+    if (!ok)
+        fprintf(stderr, "align %zu: read after commit differs\n", align);
+destroy:
+    lib->destroy(shared);
+    return ok;
+}
+
+/** Program entry point.
+ * @param argc Arguments count
+ * @param argv Arguments values
+ * @return Program return code
+**/
+int main(int argc, char** argv) {
+    static size_t const aligns[] = { 1, 8, 2, 32, 4, 16, 1, 32, 8 };
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <library path>...\n", argc > 0 ? argv[0] : "alignments");
+        return 1;
+    }
+    int failed = 0;
+    for (int i = 1; i < argc; ++i) {
+        struct library lib;
+        bool ok = library_load(&lib, argv[i]);
+        for (unsigned int j = 0; ok && j < sizeof(aligns) / sizeof(aligns[0]); ++j)
+            ok = round_run(&lib, aligns[j], j);
+        printf("%s: %s\n", argv[i], ok ? "passed" : "FAILED");
+        if (!ok)
+            failed = 1;
+    }
+    return failed;
+}
@@ -0,0 +1,137 @@
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "cm.h"
+
+/** Base-2 logarithm of the minimal and maximal backoff delays (in pauses).
+**/
+#define CM_BACKOFF_MIN 4
+#define CM_BACKOFF_MAX 14
+
+static char const* const cm_names[cm_nb_policies] = { "none", "backoff", "priority", "serial" };
+
+/**
+ * @brief State of the transaction the calling thread runs (or retries).
+ */
+static _Thread_local struct {
+    unsigned int aborts; // Consecutive aborts
+    uint64_t ticket; // Start timestamp, 0 if not taken yet
+    uint64_t seed;   // State of the random generator of the backoff delays, 0 if not seeded yet
+    bool     serial; // Whether the thread holds the serial token
+    bool     irrevocable; // Whether the thread holds the irrevocable token
+} self = { 0, 0, 0, false, false };
+
+/** Take the given token, yielding while another thread holds it.
+ * @param token Token to take
+**/
+static void cm_take(_Atomic(bool)* token) {
+    bool taken = false;
+    while (!atomic_compare_exchange_weak_explicit(token, &taken, true, memory_order_acquire, memory_order_relaxed)) {
+        taken = false;
+        sched_yield();
+    }
+}
+
+/** Draw a pseudo-random number for the calling thread.
+ * @return Pseudo-random number
+**/
+static uint64_t cm_random(void) {
+    if (unlikely(self.seed == 0))
+        self.seed = (uintptr_t) &self | 1; // Distinct per thread, never 0
+    self.seed ^= self.seed << 13; // xorshift64
+    self.seed ^= self.seed >> 7;
+    self.seed ^= self.seed << 17;
+    return self.seed;
+}
+
+void cm_init(struct cm* cm) {
+    char const* policy = getenv("TM_CM");
+    char const* after  = getenv("TM_CM_SERIAL_AFTER");
+    char const* irrevocable_after = getenv("TM_CM_IRREVOCABLE_AFTER");
+    cm->policy = cm_backoff;
+    for (int i = 0; policy && i < cm_nb_policies; ++i) {
+        if (strcmp(policy, cm_names[i]) == 0)
+            cm->policy = (enum cm_policy) i;
+    }
+    cm->serial_after = after ? (unsigned int) strtoul(after, NULL, 10) : 16;
+    cm->irrevocable_after = irrevocable_after ? (unsigned int) strtoul(irrevocable_after, NULL, 10) : 64;
+    cm->stats = getenv("TM_CM_STATS") != NULL;
+    atomic_init(&(cm->ticket), 0);
+    atomic_init(&(cm->serial), false);
+    atomic_init(&(cm->irrevocable), false);
+    for (int i = 0; i < cm_nb_causes; ++i)
+        atomic_init(&(cm->aborts[i]), 0);
+    atomic_init(&(cm->serialized), 0);
+    atomic_init(&(cm->irrevocables), 0);
+}
+
+void cm_cleanup(struct cm* cm) {
+    if (!cm->stats)
+        return;
+    fprintf(stderr, "contention manager '%s': %lu read, %lu lock, %lu validation and %lu other aborts, %lu serializations, %lu irrevocable retries\n", cm_names[cm->policy],
+        (unsigned long) atomic_load(&(cm->aborts[cm_abort_read])), (unsigned long) atomic_load(&(cm->aborts[cm_abort_lock])),
+        (unsigned long) atomic_load(&(cm->aborts[cm_abort_validate])), (unsigned long) atomic_load(&(cm->aborts[cm_abort_other])),
+        (unsigned long) atomic_load(&(cm->serialized)), (unsigned long) atomic_load(&(cm->irrevocables)));
+}
+
+uint64_t cm_begin(struct cm* cm, bool is_ro, bool* irrevocable) {
+    if (!self.irrevocable && cm->irrevocable_after > 0 && self.aborts >= cm->irrevocable_after) { // Kept if the transaction could not begin
+        cm_take(&(cm->irrevocable));
+        self.irrevocable = true;
+        if (cm->stats)
+            atomic_fetch_add_explicit(&(cm->irrevocables), 1, memory_order_relaxed);
+    }
+    *irrevocable = self.irrevocable;
+    switch (cm->policy) {
+    case cm_backoff:
+        if (self.aborts > 0 && !self.irrevocable) {
+            unsigned int shift = CM_BACKOFF_MIN + self.aborts;
+            uint64_t delay = cm_random() & ((UINT64_C(1) << (shift < CM_BACKOFF_MAX ? shift : CM_BACKOFF_MAX)) - 1);
+            while (delay-- > 0)
+                cm_pause();
+            sched_yield(); // Let the preempted conflicting transactions run
+        }
+        return 0;
+    case cm_priority:
+        if (self.ticket == 0) // New transaction, not a retry
+            self.ticket = atomic_fetch_add_explicit(&(cm->ticket), 1, memory_order_relaxed) + 1;
+        return self.ticket;
+    case cm_serial:
+        if (self.serial || self.irrevocable)
+            return 0;
+        if (self.aborts >= cm->serial_after) { // Take the token, then retry while no other read-write transaction starts
+            cm_take(&(cm->serial));
+            self.serial = true;
+            if (cm->stats)
+                atomic_fetch_add_explicit(&(cm->serialized), 1, memory_order_relaxed);
+        } else if (!is_ro) {
+            while (unlikely(atomic_load_explicit(&(cm->serial), memory_order_acquire)))
+                sched_yield();
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+void cm_abort(struct cm* cm, enum cm_cause cause) {
+    ++self.aborts;
+    if (cm->stats)
+        atomic_fetch_add_explicit(&(cm->aborts[cause]), 1, memory_order_relaxed);
+}
+
+void cm_commit(struct cm* cm) {
+    self.aborts = 0;
+    self.ticket = 0;
+    if (self.serial) {
+        self.serial = false;
+        atomic_store_explicit(&(cm->serial), false, memory_order_release);
+    }
+    if (self.irrevocable) {
+        self.irrevocable = false;
+        atomic_store_explicit(&(cm->irrevocable), false, memory_order_release);
+    }
+}
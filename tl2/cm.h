@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/** Maximum number of pauses a transaction spends waiting for a stripe locked by a younger transaction.
+**/
+#define CM_WAIT_SPINS 1024
+
+/**
+ * @brief Contention management policy, selected with the environment variable
+ * 'TM_CM' ("none", "backoff", "priority" or "serial").
+ */
+enum cm_policy {
+    cm_none,     // Retry at once
+    cm_backoff,  // Wait for a random, exponentially growing delay before retrying
+    cm_priority, // The transaction that started first (counting its retries) waits for younger ones instead of aborting
+    cm_serial,   // After 'TM_CM_SERIAL_AFTER' consecutive aborts, retry while no other read-write transaction starts
+    cm_nb_policies
+};
+
+// Note: Whatever the policy, a transaction that aborted
+// 'TM_CM_IRREVOCABLE_AFTER' consecutive times (0 for never) is retried
+// irrevocably: it takes a global token, which one thread holds at a time, and
+// the engine runs it so that it cannot abort.
+
+/**
+ * @brief Reason of an abort.
+ */
+enum cm_cause {
+    cm_abort_read,     // A read stripe was locked or too recent
+    cm_abort_lock,     // A written stripe was locked at commit time
+    cm_abort_validate, // A read stripe changed before commit time
+    cm_abort_other,    // Allocation failure
+    cm_nb_causes
+};
+
+/**
+ * @brief Contention manager of a region. The state of the transaction being
+ * retried lives in the calling thread.
+ */
+struct cm {
+    enum cm_policy policy; // Selected policy
+    unsigned int serial_after; // Consecutive aborts after which a thread takes the serial token ('cm_serial' only)
+    unsigned int irrevocable_after; // Consecutive aborts after which a thread takes the irrevocable token (0 for never)
+    bool stats; // Whether the abort counters are printed at cleanup, i.e. whether 'TM_CM_STATS' is set
+    _Alignas(64) _Atomic(uint64_t) ticket; // Last start timestamp handed out ('cm_priority' only)
+    _Alignas(64) _Atomic(bool) serial;     // Whether a thread holds the serial token ('cm_serial' only)
+    _Atomic(bool) irrevocable;             // Whether a thread holds the irrevocable token
+    _Alignas(64) _Atomic(uint64_t) aborts[cm_nb_causes]; // Aborts per cause (if 'stats' is set)
+    _Atomic(uint64_t) serialized; // Acquisitions of the serial token (if 'stats' is set)
+    _Atomic(uint64_t) irrevocables; // Acquisitions of the irrevocable token (if 'stats' is set)
+};
+
+/** Pause execution for a "short" period of time.
+**/
+static inline void cm_pause(void) {
+#if defined(__i386__) || defined(__x86_64__)
+    _mm_pause();
+#endif
+}
+
+/** Initialize the given contention manager from the environment.
+ * @param cm Contention manager to initialize
+**/
+void cm_init(struct cm* cm);
+
+/** Clean the given contention manager up, printing its counters if requested.
+ * @param cm Contention manager to clean up
+**/
+void cm_cleanup(struct cm* cm);
+
+/** [thread-safe] Apply the policy before a transaction (or a retry) of the calling thread begins.
+ * @param cm          Contention manager
+ * @param is_ro       Whether the transaction is read-only
+ * @param irrevocable Set to whether the transaction must run irrevocably (the calling thread then holds the irrevocable token)
+ * @return Start timestamp of the transaction, kept across its retries ('cm_priority' only, 0 otherwise)
+**/
+uint64_t cm_begin(struct cm* cm, bool is_ro, bool* irrevocable);
+
+/** [thread-safe] Record the abort of the transaction of the calling thread.
+ * @param cm    Contention manager
+ * @param cause Reason of the abort
+**/
+void cm_abort(struct cm* cm, enum cm_cause cause);
+
+/** [thread-safe] Record the commit of the transaction of the calling thread, releasing the tokens it holds.
+ * @param cm Contention manager
+**/
+void cm_commit(struct cm* cm);
+
+/** Tell whether a transaction waits for another one holding a lock it needs, rather than aborting.
+ * @param cm    Contention manager
+ * @param self  Start timestamp of the waiting transaction
+ * @param owner Start timestamp of the lock owner
+ * @return Whether to wait
+**/
+static inline bool cm_waits_for(struct cm const* cm, uint64_t self, uint64_t owner) {
+    return cm->policy == cm_priority && self < owner;
+}
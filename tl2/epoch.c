@@ -0,0 +1,140 @@
+// Requested feature: posix_memalign
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+
+#include "macros.h"
+#include "epoch.h"
+
+/** Value announced by a record outside of a critical section.
+**/
+#define EBR_QUIESCENT UINT64_MAX
+
+static _Atomic(uint64_t) next_id = 0; // Identifier of the next domain
+
+/**
+ * @brief Record last claimed by the calling thread, tried first by its next critical section.
+ */
+static _Thread_local struct {
+    uint64_t ebr; // Identifier of the domain of the record (0 for none)
+    struct ebr_record* record;
+} hint = { 0, NULL };
+
+/** Release the objects of the given limbo list.
+ * @param limbo Limbo list to flush
+**/
+static void ebr_limbo_flush(struct ebr_limbo* limbo) {
+    for (size_t i = 0; i < limbo->size; ++i)
+        limbo->objects[i].release(limbo->objects[i].arg, limbo->objects[i].object);
+    limbo->size = 0;
+}
+
+/** Claim a free record of the given domain.
+ * @param ebr Domain to claim from
+ * @return Claimed record, NULL on allocation failure
+**/
+static struct ebr_record* ebr_claim(struct ebr* ebr) {
+    bool idle = false;
+    if (hint.ebr == ebr->id && atomic_compare_exchange_strong_explicit(&(hint.record->used), &idle, true, memory_order_acquire, memory_order_relaxed))
+        return hint.record;
+    struct ebr_record* record = atomic_load_explicit(&(ebr->records), memory_order_acquire);
+    for (; record; record = record->next) {
+        idle = false;
+        if (atomic_compare_exchange_strong_explicit(&(record->used), &idle, true, memory_order_acquire, memory_order_relaxed))
+            break;
+    }
+    if (!record) { // Every record is in use, add one
+        if (unlikely(posix_memalign((void**) &record, 64, sizeof(struct ebr_record)) != 0))
+            return NULL;
+        atomic_init(&(record->announced), EBR_QUIESCENT);
+        atomic_init(&(record->used), true);
+        for (size_t i = 0; i < 3; ++i)
+            record->limbo[i] = (struct ebr_limbo) { 0, NULL, 0, 0 };
+        record->pending = 0;
+        record->next = atomic_load_explicit(&(ebr->records), memory_order_relaxed);
+        while (unlikely(!atomic_compare_exchange_weak_explicit(&(ebr->records), &(record->next), record, memory_order_release, memory_order_relaxed)));
+    }
+    hint.ebr    = ebr->id;
+    hint.record = record;
+    return record;
+}
+
+/** Advance the global epoch if every record in a critical section observed it.
+ * @param ebr Domain to advance
+**/
+static void ebr_try_advance(struct ebr* ebr) {
+    uint64_t epoch = atomic_load(&(ebr->epoch));
+    for (struct ebr_record* record = atomic_load(&(ebr->records)); record; record = record->next) {
+        uint64_t announced = atomic_load(&(record->announced));
+        if (announced != EBR_QUIESCENT && announced != epoch)
+            return;
+    }
+    atomic_compare_exchange_strong(&(ebr->epoch), &epoch, epoch + 1);
+}
+
+void ebr_init(struct ebr* ebr) {
+    atomic_init(&(ebr->epoch), 0);
+    atomic_init(&(ebr->records), NULL);
+    ebr->id = atomic_fetch_add_explicit(&next_id, 1, memory_order_relaxed) + 1;
+}
+
+void ebr_cleanup(struct ebr* ebr) {
+    struct ebr_record* record = atomic_load_explicit(&(ebr->records), memory_order_relaxed);
+    while (record) {
+        struct ebr_record* next = record->next;
+        for (size_t i = 0; i < 3; ++i) {
+            ebr_limbo_flush(record->limbo + i);
+            free(record->limbo[i].objects);
+        }
+        free(record);
+        record = next;
+    }
+}
+
+struct ebr_record* ebr_enter(struct ebr* ebr) {
+    struct ebr_record* record = ebr_claim(ebr);
+    if (unlikely(!record))
+        return NULL;
+    // Note: The announcement only counts once the global epoch is seen
+    // unchanged after it (both sequentially consistent); the global epoch then
+    // cannot advance by more than one before the record leaves.
+    uint64_t epoch = atomic_load(&(ebr->epoch));
+    while (true) {
+        atomic_store(&(record->announced), epoch);
+        uint64_t now = atomic_load(&(ebr->epoch));
+        if (now == epoch)
+            break;
+        epoch = now;
+    }
+    for (size_t i = 0; i < 3; ++i) { // Release, in bulk, the objects no critical section can observe anymore
+        struct ebr_limbo* limbo = record->limbo + i;
+        if (limbo->size > 0 && limbo->epoch + 2 <= epoch)
+            ebr_limbo_flush(limbo);
+    }
+    return record;
+}
+
+void ebr_leave(struct ebr* ebr, struct ebr_record* record) {
+    atomic_store_explicit(&(record->announced), EBR_QUIESCENT, memory_order_release);
+    if (record->pending >= EBR_BATCH) {
+        record->pending = 0;
+        ebr_try_advance(ebr);
+    }
+    atomic_store_explicit(&(record->used), false, memory_order_release);
+}
+
+void ebr_retire(struct ebr_record* record, void* object, void (*release)(void*, void*), void* arg) {
+    uint64_t epoch = atomic_load_explicit(&(record->announced), memory_order_relaxed);
+    struct ebr_limbo* limbo = record->limbo + epoch % 3;
+    limbo->epoch = epoch; // The list held objects at least three epochs older, hence already flushed when entering
+    if (unlikely(limbo->size == limbo->cap)) {
+        size_t cap = limbo->cap == 0 ? 16 : 2 * limbo->cap;
+        struct ebr_retired* objects = (struct ebr_retired*) realloc(limbo->objects, cap * sizeof(struct ebr_retired));
+        if (unlikely(!objects))
+            return;
+        limbo->objects = objects;
+        limbo->cap     = cap;
+    }
+    limbo->objects[limbo->size++] = (struct ebr_retired) { object, release, arg };
+    ++record->pending;
+}
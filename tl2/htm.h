@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/** Whether the hardware transactional path is compiled in, i.e. whether the
+ *  target may support Intel RTM. The functions using it are compiled with
+ *  'HTM_TARGET', hence the library builds without '-mrtm'.
+**/
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__)
+    #define HTM_AVAILABLE 1
+    #define HTM_TARGET __attribute__((target("rtm")))
+#else
+    #define HTM_AVAILABLE 0
+    #define HTM_TARGET
+#endif
+
+/** Tell whether the processor supports Intel RTM.
+ * @return Whether '_xbegin'/'_xend' can be used
+**/
+static inline bool htm_supported(void) {
+#if HTM_AVAILABLE
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 7)
+        return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & bit_RTM) != 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,87 @@
+// Requested feature: MAP_ANONYMOUS
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "orec.h"
+
+/** Stripes per word of the non-deallocable segment, and bounds of the default number of stripes (powers of 2).
+**/
+#define ORECS_PER_WORD 4
+#define ORECS_MIN_COUNT (1ul << 10)
+#define ORECS_MAX_COUNT (1ul << 20)
+
+/** Bound of the number of stripes set with 'TM_ORECS' (their table takes 1 GiB).
+**/
+#define ORECS_MAX_WANTED (ORECS_MAX_COUNT << 4)
+
+/**
+ * @brief Settings read from the environment, once per process.
+ */
+static struct {
+    pthread_once_t once;
+    bool   count_set; // Whether 'TM_ORECS' is set to a number
+    size_t count;     // Number of stripes set with 'TM_ORECS', clamped to 'ORECS_MAX_WANTED'
+    bool   stats;     // Whether 'TM_ORECS_STATS' is set
+} orec_env = { PTHREAD_ONCE_INIT, false, 0, false };
+
+/** Read the settings from the environment.
+**/
+static void orec_env_read(void) {
+    char const* count_env = getenv("TM_ORECS");
+    orec_env.stats = getenv("TM_ORECS_STATS") != NULL;
+    if (!count_env || *count_env < '0' || *count_env > '9')
+        return;
+    char* end;
+    unsigned long long count = strtoull(count_env, &end, 10);
+    if (*end != '\0')
+        return;
+    orec_env.count = count > ORECS_MAX_WANTED ? ORECS_MAX_WANTED : (size_t) count;
+    orec_env.count_set = true;
+}
+
+bool orec_table_init(struct orec_table* table, size_t size, size_t align) {
+    pthread_once(&(orec_env.once), orec_env_read);
+    bool set = orec_env.count_set;
+    size_t wanted = set ? orec_env.count : size / align * ORECS_PER_WORD;
+    if (wanted < 2)
+        wanted = 2;
+    if (!set) {
+        if (wanted < ORECS_MIN_COUNT)
+            wanted = ORECS_MIN_COUNT;
+        if (wanted > ORECS_MAX_COUNT)
+            wanted = ORECS_MAX_COUNT;
+    }
+    size_t count = 1;
+    unsigned int bits = 0;
+    while (count < wanted) {
+        count <<= 1;
+        ++bits;
+    }
+    // Note: Anonymous pages are page-aligned and zero-filled on first touch,
+    // so a region only pays for the stripes its words map to.
+    void* slots = mmap(NULL, count * sizeof(struct orec_slot), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (slots == MAP_FAILED)
+        return false;
+    table->slots = (struct orec_slot*) slots;
+    table->mask  = count - 1;
+    table->shift = 64 - bits;
+    table->word_shift = 0;
+    while (((size_t) 1 << table->word_shift) < align)
+        ++table->word_shift;
+    table->stats = orec_env.stats;
+    atomic_init(&(table->conflicts), 0);
+    atomic_init(&(table->false_conflicts), 0);
+    atomic_init(&(table->unknown_conflicts), 0);
+    return true;
+}
+
+void orec_table_cleanup(struct orec_table* table) {
+    if (table->stats)
+        fprintf(stderr, "versioned locks: %lu stripes, %lu read conflicts of which %lu false and %lu on a stripe locked before any write\n", (unsigned long) (table->mask + 1),
+            (unsigned long) atomic_load(&(table->conflicts)), (unsigned long) atomic_load(&(table->false_conflicts)), (unsigned long) atomic_load(&(table->unknown_conflicts)));
+    munmap(table->slots, (table->mask + 1) * sizeof(struct orec_slot));
+}
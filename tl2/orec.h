@@ -0,0 +1,153 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A versioned lock (a.k.a. ownership record). When free, the word holds
+ * the version (i.e. commit timestamp) of the last write shifted left by one
+ * bit. When taken, the lowest bit is set and the word holds the (even)
+ * identifier of the owning transaction.
+ */
+typedef _Atomic(uintptr_t) orec_t;
+
+/** Value of 'last' for a stripe of which the last commit wrote several words.
+**/
+#define OREC_LAST_MANY UINTPTR_MAX
+
+/**
+ * @brief Stripe of the table, alone in its cache line.
+ */
+struct orec_slot {
+    _Alignas(64) orec_t lock; // Versioned lock
+    _Atomic(uintptr_t) last; // Word written by the last commit that released the lock, 'OREC_LAST_MANY' if several (only kept with statistics)
+};
+
+/**
+ * @brief Table of versioned locks, each shared memory word being mapped to
+ * one stripe of the table by a multiplicative hash.
+ */
+struct orec_table {
+    struct orec_slot* slots; // Stripes
+    size_t mask; // Number of stripes minus one (the number of stripes is a power of 2)
+    unsigned int shift; // Shift of a hash giving the stripe, i.e. 64 minus the base-2 logarithm of the number of stripes
+    unsigned int word_shift; // Base-2 logarithm of the size of a word
+    bool stats; // Whether conflicts are counted, i.e. whether 'TM_ORECS_STATS' is set
+    _Alignas(64) _Atomic(uint64_t) conflicts; // Reads that found their stripe locked or too recent (if 'stats' is set)
+    _Atomic(uint64_t) false_conflicts; // Such reads of a word other than the one last written in the stripe (if 'stats' is set)
+    _Atomic(uint64_t) unknown_conflicts; // Such reads of a stripe locked by a commit that did not write yet, hence neither true nor false (if 'stats' is set)
+};
+
+/** Initialize the given table, sized after the non-deallocable segment or set with the environment variable 'TM_ORECS'.
+ * @param table Table to initialize
+ * @param size  Size of the non-deallocable segment (in bytes)
+ * @param align Size of a word (in bytes)
+ * @return Whether the operation is a success
+**/
+bool orec_table_init(struct orec_table* table, size_t size, size_t align);
+
+/** Clean the given table up, printing its statistics if requested.
+ * @param table Table to clean up
+**/
+void orec_table_cleanup(struct orec_table* table);
+
+/** Get the versioned lock protecting the given shared memory address.
+ * @param table Table to query
+ * @param addr  Address in shared memory
+ * @return Versioned lock of the stripe
+**/
+static inline orec_t* orec_get(struct orec_table const* table, void const* addr) {
+    // Note: Neighbouring words (e.g. a segment header and the data following
+    // it) are spread over distant stripes, rather than falling in one stripe
+    // or in neighbouring ones.
+    uint64_t word = (uintptr_t) addr >> table->word_shift;
+    return &(table->slots[(word * UINT64_C(0x9E3779B97F4A7C15)) >> table->shift].lock);
+}
+
+/** Get the stripe of the given versioned lock.
+ * @param orec Versioned lock
+ * @return Stripe of the lock
+**/
+static inline struct orec_slot* orec_slot_of(orec_t* orec) {
+    return (struct orec_slot*) orec; // The lock is the first member
+}
+
+/** Record that the given versioned lock was just taken by a committing transaction, if statistics are kept.
+ * @param table Table of the lock
+ * @param orec  Versioned lock, held by the caller
+**/
+static inline void orec_note_lock(struct orec_table const* table, orec_t* orec) {
+    if (table->stats)
+        atomic_store_explicit(&(orec_slot_of(orec)->last), 0, memory_order_relaxed);
+}
+
+/** Record that the commit holding the given versioned lock writes the given word, if statistics are kept.
+ * @param table Table of the lock
+ * @param orec  Versioned lock, held by the caller
+ * @param word  Address of the written word
+**/
+static inline void orec_note_write(struct orec_table const* table, orec_t* orec, void const* word) {
+    if (!table->stats)
+        return;
+    _Atomic(uintptr_t)* last = &(orec_slot_of(orec)->last);
+    uintptr_t prev = atomic_load_explicit(last, memory_order_relaxed);
+    atomic_store_explicit(last, prev == 0 || prev == (uintptr_t) word ? (uintptr_t) word : OREC_LAST_MANY, memory_order_relaxed);
+}
+
+/** Count a conflict of a read of the given word on the given stripe, if statistics are kept.
+ * @param table Table of the lock
+ * @param orec  Versioned lock of the stripe
+ * @param word  Address of the read word
+**/
+static inline void orec_note_conflict(struct orec_table* table, orec_t* orec, void const* word) {
+    if (!table->stats)
+        return;
+    atomic_fetch_add_explicit(&(table->conflicts), 1, memory_order_relaxed);
+    uintptr_t last = atomic_load_explicit(&(orec_slot_of(orec)->last), memory_order_relaxed);
+    if (last == 0) // Locked, the written words are not known yet
+        atomic_fetch_add_explicit(&(table->unknown_conflicts), 1, memory_order_relaxed);
+    else if (last != OREC_LAST_MANY && last != (uintptr_t) word)
+        atomic_fetch_add_explicit(&(table->false_conflicts), 1, memory_order_relaxed);
+}
+
+/** Tell whether the given versioned lock value is locked.
+ * @param value Value of the versioned lock
+ * @return Whether the lock is taken
+**/
+static inline bool orec_is_locked(uintptr_t value) {
+    return (value & 1) != 0;
+}
+
+/** Get the version held by the given (unlocked) versioned lock value.
+ * @param value Value of the versioned lock
+ * @return Version
+**/
+static inline uint64_t orec_version(uintptr_t value) {
+    return value >> 1;
+}
+
+/** Get the identifier of the owner of the given (locked) versioned lock value.
+ * @param value Value of the versioned lock
+ * @return Owner identifier
+**/
+static inline uintptr_t orec_owner(uintptr_t value) {
+    return value & ~(uintptr_t) 1;
+}
+
+/** Build the value of a versioned lock taken by the given owner.
+ * @param owner Owner identifier (even)
+ * @return Value of the taken lock
+**/
+static inline uintptr_t orec_owned_by(uintptr_t owner) {
+    return owner | 1;
+}
+
+/** Build the value of a free versioned lock holding the given version.
+ * @param version Version to hold
+ * @return Value of the free lock
+**/
+static inline uintptr_t orec_versioned(uint64_t version) {
+    return (uintptr_t) version << 1;
+}
@@ -0,0 +1,781 @@
+/**
+ * @file   tm.c
+ * @author [...]
+ *
+ * @section LICENSE
+ *
+ * [...]
+ *
+ * @section DESCRIPTION
+ *
+ * Word-based transaction manager in the style of TL2 (Dice, Shalev & Shavit):
+ * a global version clock, a table of striped versioned locks, invisible reads
+ * validated against the version clock and buffered writes that are published
+ * at commit time while holding the locks of the written stripes.
+ *
+ * Aborted transactions are retried under the policy of a contention manager,
+ * selected with the environment variable 'TM_CM' (see 'cm.h'); setting
+ * 'TM_CM_STATS' prints the number of aborts per cause when the region is
+ * destroyed. A transaction retried too many times runs irrevocably: it locks
+ * every stripe it accesses, waiting for their owners, and writes in place.
+ *
+ * On processors supporting Intel RTM, the commit of a read-write transaction
+ * is first tried as a hardware transaction, that validates the read set and
+ * publishes the write set while subscribed to their versioned locks, instead
+ * of taking the locks. It falls back to the software commit after
+ * 'TM_HTM_RETRIES' (4 by default, 0 disables the hardware path) attempts.
+**/
+
+// Requested features
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE   200809L
+#ifdef __STDC_NO_ATOMICS__
+    #error Current C11 compiler does not support atomic operations
+#endif
+
+// External headers
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internal headers
+#include <tm.h>
+
+#include "macros.h"
+#include "cm.h"
+#include "epoch.h"
+#include "htm.h"
+#include "orec.h"
+#include "tx-pool.h"
+#include "write-index.h"
+
+/** Number of pauses a committing transaction spends waiting for a locked stripe before aborting.
+**/
+#define COMMIT_LOCK_SPINS 128
+
+/** Largest number of stripes sorted by insertion rather than with 'qsort'.
+**/
+#define STRIPES_INSERTION_SORT 16
+
+/**
+ * @brief Dynamically allocated segment, the segment data follows the header.
+ */
+struct segment_node {
+    struct segment_node* prev;
+    struct segment_node* next;
+    // uint8_t segment[] // segment of dynamic size, starting at 'header' bytes from the node
+};
+
+/**
+ * @brief Shared memory region, i.e. transactional memory.
+ */
+struct region {
+    _Alignas(64) _Atomic(uint64_t) clock; // Global version clock, alone in its cache line
+    _Alignas(64) struct orec_table orecs; // Striped versioned locks
+    void*  start;  // Start of the shared memory region (i.e., of the non-deallocable memory segment)
+    size_t size;   // Size of the non-deallocable memory segment (in bytes)
+    size_t align;  // Size of a word in the shared memory region (in bytes)
+    size_t header; // Size of the header preceding each dynamically allocated segment (in bytes)
+    pthread_mutex_t allocs_lock; // Lock protecting 'allocs'
+    struct segment_node* allocs; // Segments dynamically allocated by committed transactions, and not freed yet
+    struct ebr ebr; // Reclamation of the freed segments
+    struct cm cm;   // Contention manager
+    unsigned int htm_retries; // Hardware commit attempts before the software commit (0 if RTM is not supported)
+};
+
+/**
+ * @brief Grow-on-demand array of fixed-size elements.
+ */
+struct vector {
+    void*  data; // Elements
+    size_t size; // Number of elements in use
+    size_t cap;  // Number of allocated elements
+};
+
+/** Append one (uninitialized) element to the given vector.
+ * @param vec  Vector to append to
+ * @param elem Size of one element (in bytes)
+ * @return Address of the appended element, NULL on allocation failure
+**/
+static void* vector_push(struct vector* vec, size_t elem) {
+    if (unlikely(vec->size == vec->cap)) {
+        size_t cap = vec->cap == 0 ? 16 : 2 * vec->cap;
+        void* data = realloc(vec->data, cap * elem);
+        if (unlikely(!data))
+            return NULL;
+        vec->data = data;
+        vec->cap  = cap;
+    }
+    return (char*) vec->data + elem * vec->size++;
+}
+
+/**
+ * @brief Versioned lock taken at commit time, with its value before locking.
+ */
+struct lock_entry {
+    orec_t*   orec;
+    uintptr_t prev;
+};
+
+/**
+ * @brief Transaction descriptor, recycled through the pool of the thread that ran it.
+ */
+struct tx {
+    struct tx_pool_link link; // Link in the pool of recycled descriptors
+    bool     is_ro; // Whether the transaction is read-only
+    bool     irrevocable; // Whether the transaction runs irrevocably, i.e. holds the irrevocable token
+    bool     overflow;    // Whether some stripes locked by the irrevocable transaction are missing from 'locks'
+    uint64_t rv;    // Read version, i.e. value of the global clock at begin
+    uint64_t ticket; // Start timestamp given by the contention manager (0 if none)
+    uintptr_t owner; // Identifier held by the versioned locks the transaction takes
+    struct vector reads;  // Versioned locks of the read stripes (orec_t*)
+    struct vector writes; // Written words, in order of first write (void*)
+    struct vector data;   // Buffered value of each written word ('align' bytes each)
+    size_t   align; // Word size of the region the transaction runs on, in which the capacity of 'data' is counted
+    struct write_index index; // Position of each written word in 'writes'
+    struct vector stripes; // Distinct stripes of the write set, sorted by address at commit time (orec_t*)
+    struct vector locks;  // Versioned locks taken at commit time, in address order but for irrevocable transactions (struct lock_entry)
+    struct vector allocs; // Segments allocated by this transaction (struct segment_node*)
+    struct vector frees;  // Segments freed by this transaction (struct segment_node*)
+    struct ebr_record* ebr; // Critical section of the transaction, keeping the segments it may access allocated
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Free the given pooled descriptor.
+ * @param link Link of the descriptor to free
+**/
+static void tx_free(struct tx_pool_link* link) {
+    struct tx* tx = (struct tx*) link;
+    free(tx->reads.data);
+    free(tx->writes.data);
+    free(tx->data.data);
+    free(tx->stripes.data);
+    free(tx->locks.data);
+    free(tx->allocs.data);
+    free(tx->frees.data);
+    write_index_cleanup(&(tx->index));
+    free(tx);
+}
+
+/** Leave the critical section of the given (ended) transaction, reset it and give it back to the pool of the calling thread.
+ * @param region Region the transaction ran on
+ * @param tx     Transaction to release
+**/
+static void tx_release(struct region* region, struct tx* tx) {
+    ebr_leave(&(region->ebr), tx->ebr);
+    tx->reads.size  = 0;
+    tx->writes.size = 0;
+    tx->data.size   = 0;
+    tx->locks.size  = 0;
+    tx->allocs.size = 0;
+    tx->frees.size  = 0;
+    tx->overflow    = false;
+    write_index_reset(&(tx->index));
+    tx_pool_give(&(tx->link), tx_free);
+}
+
+/** Abort the given transaction: release the taken locks and the segments it allocated.
+ * @param region Region the transaction ran on
+ * @param tx     Transaction to abort
+ * @param cause  Reason of the abort
+**/
+static void tx_abort(struct region* region, struct tx* tx, enum cm_cause cause) {
+    cm_abort(&(region->cm), cause);
+    struct lock_entry* locks = (struct lock_entry*) tx->locks.data;
+    for (size_t i = 0; i < tx->locks.size; ++i)
+        atomic_store_explicit(locks[i].orec, locks[i].prev, memory_order_release);
+    struct segment_node** allocs = (struct segment_node**) tx->allocs.data;
+    for (size_t i = 0; i < tx->allocs.size; ++i)
+        free(allocs[i]);
+    tx_release(region, tx);
+}
+
+/** Find the buffered value of the given word in the write set.
+ * @param tx    Transaction to query
+ * @param word  Address of the word in shared memory
+ * @param align Size of a word (in bytes)
+ * @return Address of the buffered value, NULL if the word was not written
+**/
+static void* tx_find_write(struct tx const* tx, void const* word, size_t align) {
+    size_t entry = write_index_find(&(tx->index), word);
+    return entry == WRITE_INDEX_NONE ? NULL : (char*) tx->data.data + entry * align;
+}
+
+/** Make the segments allocated by the given (committed) transaction part of the region.
+ * @param region Region to insert the segments into
+ * @param tx     Committed transaction
+**/
+static void tx_publish_allocs(struct region* region, struct tx const* tx) {
+    if (tx->allocs.size == 0)
+        return;
+    struct segment_node** allocs = (struct segment_node**) tx->allocs.data;
+    pthread_mutex_lock(&(region->allocs_lock));
+    for (size_t i = 0; i < tx->allocs.size; ++i) {
+        struct segment_node* sn = allocs[i];
+        sn->prev = NULL;
+        sn->next = region->allocs;
+        if (sn->next)
+            sn->next->prev = sn;
+        region->allocs = sn;
+    }
+    pthread_mutex_unlock(&(region->allocs_lock));
+}
+
+/** Release a freed segment, once no transaction can access it anymore.
+ * @param arg Unused
+ * @param sn  Segment to release
+**/
+static void segment_release(void* unused(arg), void* sn) {
+    free(sn);
+}
+
+/** Remove the segments freed by the given (committed) transaction from the region, and retire them.
+ * @param region Region to remove the segments from
+ * @param tx     Committed transaction
+**/
+static void tx_retire_frees(struct region* region, struct tx const* tx) {
+    if (tx->frees.size == 0)
+        return;
+    struct segment_node** frees = (struct segment_node**) tx->frees.data;
+    pthread_mutex_lock(&(region->allocs_lock));
+    for (size_t i = 0; i < tx->frees.size; ++i) {
+        struct segment_node* sn = frees[i];
+        if (sn->prev) {
+            sn->prev->next = sn->next;
+        } else {
+            region->allocs = sn->next;
+        }
+        if (sn->next)
+            sn->next->prev = sn->prev;
+    }
+    pthread_mutex_unlock(&(region->allocs_lock));
+    for (size_t i = 0; i < tx->frees.size; ++i)
+        ebr_retire(tx->ebr, frees[i], segment_release, NULL);
+}
+
+/** Check that the version held by the given stripe was not modified since the transaction began.
+ * @param tx   Transaction to validate
+ * @param orec Versioned lock of the stripe
+ * @return Whether the stripe is still consistent with the read version
+**/
+static bool tx_validate_orec(struct tx const* tx, orec_t* orec) {
+    uintptr_t value = atomic_load_explicit(orec, memory_order_acquire);
+    if (value == orec_owned_by(tx->owner)) { // Locked by ourself at commit time, check the version before locking
+        struct lock_entry const* locks = (struct lock_entry const*) tx->locks.data;
+        size_t low = 0, high = tx->locks.size;
+        while (low < high) { // The locks were taken in address order
+            size_t mid = low + (high - low) / 2;
+            if (locks[mid].orec == orec)
+                return orec_version(locks[mid].prev) <= tx->rv;
+            if (locks[mid].orec < orec) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return false;
+    }
+    return !orec_is_locked(value) && orec_version(value) <= tx->rv;
+}
+
+/** Wait for the given locked stripe to be released, if the contention manager lets the transaction wait for its owner.
+ * @param region Region the transaction runs on
+ * @param tx     Waiting transaction
+ * @param orec   Versioned lock of the stripe
+ * @param value  Value of the versioned lock
+ * @return Last value of the versioned lock, still locked if the transaction must abort instead
+**/
+static uintptr_t tx_wait_orec(struct region* region, struct tx const* tx, orec_t* orec, uintptr_t value) {
+    // Note: Under the priority policy, the owner identifier is the start
+    // timestamp of the owner shifted left by one bit, hence the priorities are
+    // compared without accessing the descriptor of the owner.
+    for (size_t spins = 0; orec_is_locked(value) && spins < CM_WAIT_SPINS && cm_waits_for(&(region->cm), tx->ticket, orec_owner(value) >> 1); ++spins) {
+        cm_pause();
+        value = atomic_load_explicit(orec, memory_order_acquire);
+    }
+    return value;
+}
+
+/** Lock the given stripe for the given irrevocable transaction, waiting for its owner to release it.
+ * @param region Region the transaction runs on
+ * @param tx     Irrevocable transaction
+ * @param orec   Versioned lock of the stripe
+**/
+static void tx_lock_irrevocable(struct region* region, struct tx* tx, orec_t* orec) {
+    // Note: The other owners are committing transactions, that release their
+    // locks (or abort) without waiting for the irrevocable transaction for long.
+    uintptr_t const owned = orec_owned_by(tx->owner);
+    uintptr_t value = atomic_load_explicit(orec, memory_order_relaxed);
+    while (value != owned) {
+        if (orec_is_locked(value)) {
+            sched_yield();
+            value = atomic_load_explicit(orec, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(orec, &value, owned, memory_order_acquire, memory_order_relaxed)) {
+            orec_note_lock(&(region->orecs), orec);
+            struct lock_entry* entry = (struct lock_entry*) vector_push(&(tx->locks), sizeof(struct lock_entry));
+            if (unlikely(!entry)) { // Cannot abort anymore, the lock is found back at commit time
+                tx->overflow = true;
+                return;
+            }
+            entry->orec = orec;
+            entry->prev = value;
+            return;
+        }
+    }
+}
+
+/** Commit the given irrevocable transaction, whose writes are already in place.
+ * @param region Region the transaction runs on
+ * @param tx     Transaction to commit
+**/
+static void tx_commit_irrevocable(struct region* region, struct tx* tx) {
+    if (tx->locks.size > 0 || tx->overflow) { // Release the locks with a new version, read-only stripes included
+        uintptr_t const released = orec_versioned(atomic_fetch_add_explicit(&(region->clock), 1, memory_order_acq_rel) + 1);
+        struct lock_entry* locks = (struct lock_entry*) tx->locks.data;
+        for (size_t i = 0; i < tx->locks.size; ++i)
+            atomic_store_explicit(locks[i].orec, released, memory_order_release);
+        if (unlikely(tx->overflow)) {
+            uintptr_t const owned = orec_owned_by(tx->owner);
+            for (size_t i = 0; i <= region->orecs.mask; ++i) {
+                if (atomic_load_explicit(&(region->orecs.slots[i].lock), memory_order_relaxed) == owned)
+                    atomic_store_explicit(&(region->orecs.slots[i].lock), released, memory_order_release);
+            }
+        }
+        tx->locks.size = 0;
+    }
+    tx_publish_allocs(region, tx);
+    tx_retire_frees(region, tx);
+}
+
+/** Compare two stripes by address, for 'qsort'.
+ * @param a Pointer to the first stripe
+ * @param b Pointer to the second stripe
+ * @return Negative, zero or positive if the first stripe is before, at or after the second one
+**/
+static int orec_compare(void const* a, void const* b) {
+    orec_t* x = *(orec_t* const*) a;
+    orec_t* y = *(orec_t* const*) b;
+    return (x > y) - (x < y);
+}
+
+/** Gather the distinct stripes of the write set of the given transaction, sorted by address.
+ * @param region Region the transaction runs on
+ * @param tx     Transaction whose 'stripes' to fill
+ * @return Whether the operation is a success
+**/
+static bool tx_sort_stripes(struct region const* region, struct tx* tx) {
+    void* const* writes = (void* const*) tx->writes.data;
+    tx->stripes.size = 0;
+    for (size_t i = 0; i < tx->writes.size; ++i) {
+        orec_t** entry = (orec_t**) vector_push(&(tx->stripes), sizeof(orec_t*));
+        if (unlikely(!entry))
+            return false;
+        *entry = orec_get(&(region->orecs), writes[i]);
+    }
+    orec_t** stripes = (orec_t**) tx->stripes.data;
+    size_t nb = tx->stripes.size;
+    if (nb <= STRIPES_INSERTION_SORT) {
+        for (size_t i = 1; i < nb; ++i) {
+            orec_t* stripe = stripes[i];
+            size_t j = i;
+            for (; j > 0 && stripes[j - 1] > stripe; --j)
+                stripes[j] = stripes[j - 1];
+            stripes[j] = stripe;
+        }
+    } else {
+        qsort(stripes, nb, sizeof(orec_t*), orec_compare);
+    }
+    size_t distinct = 0; // Several written words in the same stripe
+    for (size_t i = 0; i < nb; ++i) {
+        if (distinct == 0 || stripes[distinct - 1] != stripes[i])
+            stripes[distinct++] = stripes[i];
+    }
+    tx->stripes.size = distinct;
+    return true;
+}
+
+/**
+ * @brief Outcome of a hardware commit.
+ */
+enum htm_outcome {
+    htm_committed, // Committed
+    htm_invalid,   // A read stripe changed since the transaction began
+    htm_locked,    // A stripe is locked by a software commit
+    htm_fallback   // Out of attempts, commit in software
+};
+
+/** Explicit abort codes of the hardware commit.
+**/
+#define HTM_ABORT_INVALID 1
+#define HTM_ABORT_LOCKED  2
+
+#if HTM_AVAILABLE
+/** Try to commit the given read-write transaction, having a non-empty write set, with hardware transactions.
+ * @param region Region the transaction runs on
+ * @param tx     Transaction to commit
+ * @return Outcome of the commit
+**/
+static HTM_TARGET enum htm_outcome tx_commit_htm(struct region* region, struct tx* tx) {
+    size_t const align = region->align;
+    void* const* writes = (void* const*) tx->writes.data;
+    orec_t* const* reads = (orec_t* const*) tx->reads.data;
+    for (unsigned int attempt = 0; attempt < region->htm_retries; ++attempt) {
+        unsigned int status = _xbegin();
+        if (status == _XBEGIN_STARTED) {
+            // Reading the versioned locks subscribes to them: a software commit taking one aborts this hardware transaction
+            for (size_t i = 0; i < tx->reads.size; ++i) {
+                uintptr_t value = atomic_load_explicit(reads[i], memory_order_relaxed);
+                if (orec_is_locked(value) || orec_version(value) > tx->rv)
+                    _xabort(HTM_ABORT_INVALID);
+            }
+            for (size_t i = 0; i < tx->writes.size; ++i) {
+                if (orec_is_locked(atomic_load_explicit(orec_get(&(region->orecs), writes[i]), memory_order_relaxed)))
+                    _xabort(HTM_ABORT_LOCKED);
+            }
+            uintptr_t const released = orec_versioned(atomic_fetch_add_explicit(&(region->clock), 1, memory_order_relaxed) + 1);
+            for (size_t i = 0; region->orecs.stats && i < tx->writes.size; ++i)
+                orec_note_lock(&(region->orecs), orec_get(&(region->orecs), writes[i]));
+            for (size_t i = 0; i < tx->writes.size; ++i) {
+                orec_t* orec = orec_get(&(region->orecs), writes[i]);
+                memcpy(writes[i], (char const*) tx->data.data + i * align, align);
+                orec_note_write(&(region->orecs), orec, writes[i]);
+                atomic_store_explicit(orec, released, memory_order_relaxed);
+            }
+            _xend();
+            return htm_committed;
+        }
+        if (status & _XABORT_EXPLICIT)
+            return _XABORT_CODE(status) == HTM_ABORT_INVALID ? htm_invalid : htm_locked;
+        if (!(status & _XABORT_RETRY))
+            break;
+    }
+    return htm_fallback;
+}
+#else
+static enum htm_outcome tx_commit_htm(struct region* unused(region), struct tx* unused(tx)) {
+    return htm_fallback;
+}
+#endif
+
+/** Try to commit the given read-write transaction.
+ * @param region Region the transaction runs on
+ * @param tx     Transaction to commit
+ * @param cause  Reason of the abort, set on failure
+ * @return Whether the transaction committed
+**/
+static bool tx_commit(struct region* region, struct tx* tx, enum cm_cause* cause) {
+    size_t const align = region->align;
+    void* const* writes = (void* const*) tx->writes.data;
+    size_t const nbwrites = tx->writes.size;
+    if (nbwrites == 0) { // Nothing to publish: the reads were consistent with 'rv'
+        tx_publish_allocs(region, tx);
+        tx_retire_frees(region, tx);
+        return true;
+    }
+    if (region->htm_retries > 0) {
+        switch (tx_commit_htm(region, tx)) {
+        case htm_committed:
+            tx_publish_allocs(region, tx);
+            tx_retire_frees(region, tx);
+            return true;
+        case htm_invalid:
+            *cause = cm_abort_validate;
+            return false;
+        case htm_locked:
+            *cause = cm_abort_lock;
+            return false;
+        default: // Commit in software
+            break;
+        }
+    }
+    // Lock the stripes of the write set in address order, so that committing transactions can wait for each other without deadlocking
+    if (unlikely(!tx_sort_stripes(region, tx))) {
+        *cause = cm_abort_other;
+        return false;
+    }
+    orec_t* const* stripes = (orec_t* const*) tx->stripes.data;
+    for (size_t i = 0; i < tx->stripes.size; ++i) {
+        orec_t* orec = stripes[i];
+        uintptr_t value = atomic_load_explicit(orec, memory_order_relaxed);
+        for (size_t spins = 0;;) {
+            if (!orec_is_locked(value)) {
+                if (atomic_compare_exchange_weak_explicit(orec, &value, orec_owned_by(tx->owner), memory_order_acquire, memory_order_relaxed))
+                    break;
+                continue;
+            }
+            if (spins >= COMMIT_LOCK_SPINS && (spins >= CM_WAIT_SPINS || !cm_waits_for(&(region->cm), tx->ticket, orec_owner(value) >> 1))) {
+                *cause = cm_abort_lock;
+                return false;
+            }
+            ++spins;
+            cm_pause();
+            value = atomic_load_explicit(orec, memory_order_relaxed);
+        }
+        orec_note_lock(&(region->orecs), orec);
+        struct lock_entry* entry = (struct lock_entry*) vector_push(&(tx->locks), sizeof(struct lock_entry));
+        if (unlikely(!entry)) {
+            atomic_store_explicit(orec, value, memory_order_relaxed);
+            *cause = cm_abort_other;
+            return false;
+        }
+        entry->orec = orec;
+        entry->prev = value;
+    }
+    // Get the write version, and validate the read set if another transaction committed in between
+    uint64_t wv = atomic_fetch_add_explicit(&(region->clock), 1, memory_order_acq_rel) + 1;
+    if (wv != tx->rv + 1) {
+        orec_t** reads = (orec_t**) tx->reads.data;
+        for (size_t i = 0; i < tx->reads.size; ++i) {
+            if (!tx_validate_orec(tx, reads[i])) {
+                *cause = cm_abort_validate;
+                return false;
+            }
+        }
+    }
+    // Write back then release the locks with the new version
+    for (size_t i = 0; i < nbwrites; ++i) {
+        memcpy(writes[i], (char const*) tx->data.data + i * align, align);
+        orec_note_write(&(region->orecs), orec_get(&(region->orecs), writes[i]), writes[i]);
+    }
+    struct lock_entry* locks = (struct lock_entry*) tx->locks.data;
+    for (size_t i = 0; i < tx->locks.size; ++i)
+        atomic_store_explicit(locks[i].orec, orec_versioned(wv), memory_order_release);
+    tx->locks.size = 0;
+    tx_publish_allocs(region, tx);
+    tx_retire_frees(region, tx);
+    return true;
+}
+
+// -------------------------------------------------------------------------- //
+
+shared_t tm_create(size_t size, size_t align) {
+    struct region* region;
+    if (unlikely(posix_memalign((void**) &region, 64, sizeof(struct region)) != 0))
+        return invalid_shared;
+    size_t align_alloc = align < sizeof(void*) ? sizeof(void*) : align;
+    if (unlikely(posix_memalign(&(region->start), align_alloc, size) != 0)) {
+        free(region);
+        return invalid_shared;
+    }
+    if (unlikely(!orec_table_init(&(region->orecs), size, align))) {
+        free(region->start);
+        free(region);
+        return invalid_shared;
+    }
+    if (unlikely(pthread_mutex_init(&(region->allocs_lock), NULL) != 0)) {
+        orec_table_cleanup(&(region->orecs));
+        free(region->start);
+        free(region);
+        return invalid_shared;
+    }
+    memset(region->start, 0, size);
+    atomic_init(&(region->clock), 0);
+    region->allocs = NULL;
+    ebr_init(&(region->ebr));
+    cm_init(&(region->cm));
+    char const* htm_retries = getenv("TM_HTM_RETRIES");
+    region->htm_retries = htm_supported() ? (htm_retries ? (unsigned int) strtoul(htm_retries, NULL, 10) : 4) : 0;
+    region->size   = size;
+    region->align  = align;
+    region->header = (sizeof(struct segment_node) + align_alloc - 1) / align_alloc * align_alloc;
+    return region;
+}
+
+void tm_destroy(shared_t shared) {
+    struct region* region = (struct region*) shared;
+    struct segment_node* sn = region->allocs;
+    while (sn) { // Free allocated segments
+        struct segment_node* tail = sn->next;
+        free(sn);
+        sn = tail;
+    }
+    ebr_cleanup(&(region->ebr)); // Free retired segments
+    cm_cleanup(&(region->cm));
+    pthread_mutex_destroy(&(region->allocs_lock));
+    orec_table_cleanup(&(region->orecs));
+    free(region->start);
+    free(region);
+}
+
+void* tm_start(shared_t shared) {
+    return ((struct region*) shared)->start;
+}
+
+size_t tm_size(shared_t shared) {
+    return ((struct region*) shared)->size;
+}
+
+size_t tm_align(shared_t shared) {
+    return ((struct region*) shared)->align;
+}
+
+tx_t tm_begin(shared_t shared, bool is_ro) {
+    bool irrevocable;
+    uint64_t ticket = cm_begin(&(((struct region*) shared)->cm), is_ro, &irrevocable);
+    struct tx* tx = (struct tx*) tx_pool_take(); // Descriptors, and their logs, are reused across the transactions (and retries) of the thread
+    if (!tx)
+        tx = (struct tx*) calloc(1, sizeof(struct tx));
+    if (unlikely(!tx))
+        return invalid_tx;
+    tx->ebr = ebr_enter(&(((struct region*) shared)->ebr));
+    if (unlikely(!tx->ebr)) {
+        tx_free(&(tx->link));
+        return invalid_tx;
+    }
+    size_t align = ((struct region*) shared)->align;
+    if (unlikely(tx->align != align)) { // Last ran on a region with another word size
+        tx->data.cap = tx->align != 0 ? tx->data.cap * tx->align / align : 0;
+        tx->align    = align;
+    }
+    tx->is_ro  = is_ro;
+    tx->irrevocable = irrevocable;
+    tx->ticket = ticket;
+    tx->owner  = ticket != 0 ? (uintptr_t) ticket << 1 : (uintptr_t) tx;
+    tx->rv     = atomic_load_explicit(&(((struct region*) shared)->clock), memory_order_acquire);
+    return (tx_t) tx;
+}
+
+bool tm_end(shared_t shared, tx_t tx) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    enum cm_cause cause;
+    if (unlikely(t->irrevocable)) {
+        tx_commit_irrevocable(region, t);
+    } else if (!t->is_ro && unlikely(!tx_commit(region, t, &cause))) { // Read-only: every read was already validated against 'rv'
+        tx_abort(region, t, cause);
+        return false;
+    }
+    cm_commit(&(region->cm));
+    tx_release(region, t);
+    return true;
+}
+
+bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    size_t const align = region->align;
+    if (unlikely(t->irrevocable)) { // Lock then read in place
+        for (size_t offset = 0; offset < size; offset += align)
+            tx_lock_irrevocable(region, t, orec_get(&(region->orecs), (char const*) source + offset));
+        memcpy(target, source, size);
+        return true;
+    }
+    for (size_t offset = 0; offset < size; offset += align) {
+        void const* word = (char const*) source + offset;
+        void* dest = (char*) target + offset;
+        if (!t->is_ro) { // Read-after-write
+            void const* buffered = tx_find_write(t, word, align);
+            if (buffered) {
+                memcpy(dest, buffered, align);
+                continue;
+            }
+        }
+        // Sample the versioned lock before and after reading the word
+        orec_t* orec = orec_get(&(region->orecs), word);
+        uintptr_t before = atomic_load_explicit(orec, memory_order_acquire);
+        if (unlikely(orec_is_locked(before)))
+            before = tx_wait_orec(region, t, orec, before);
+        memcpy(dest, word, align);
+        atomic_thread_fence(memory_order_acquire);
+        uintptr_t after = atomic_load_explicit(orec, memory_order_relaxed);
+        if (unlikely(before != after || orec_is_locked(before) || orec_version(before) > t->rv)) {
+            orec_note_conflict(&(region->orecs), orec, word);
+            goto abort;
+        }
+        if (!t->is_ro) {
+            orec_t** entry = (orec_t**) vector_push(&(t->reads), sizeof(orec_t*));
+            if (unlikely(!entry)) {
+                tx_abort(region, t, cm_abort_other);
+                return false;
+            }
+            *entry = orec;
+        }
+    }
+    return true;
+abort:
+    tx_abort(region, t, cm_abort_read);
+    return false;
+}
+
+bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    size_t const align = region->align;
+    if (unlikely(t->irrevocable)) { // Lock then write in place
+        for (size_t offset = 0; offset < size; offset += align) {
+            orec_t* orec = orec_get(&(region->orecs), (char*) target + offset);
+            tx_lock_irrevocable(region, t, orec);
+            orec_note_write(&(region->orecs), orec, (char*) target + offset);
+        }
+        memcpy(target, source, size);
+        return true;
+    }
+    for (size_t offset = 0; offset < size; offset += align) {
+        void* word = (char*) target + offset;
+        void* buffered = tx_find_write(t, word, align);
+        if (!buffered) {
+            void** entry = (void**) vector_push(&(t->writes), sizeof(void*));
+            if (unlikely(!entry))
+                goto abort;
+            buffered = vector_push(&(t->data), align);
+            if (unlikely(!buffered)) {
+                --t->writes.size;
+                goto abort;
+            }
+            if (unlikely(!write_index_insert(&(t->index), word, t->writes.size - 1))) {
+                --t->writes.size;
+                --t->data.size;
+                goto abort;
+            }
+            *entry = word;
+        }
+        memcpy(buffered, (char const*) source + offset, align);
+    }
+    return true;
+abort:
+    tx_abort(region, t, cm_abort_other);
+    return false;
+}
+
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    size_t align = region->align < sizeof(void*) ? sizeof(void*) : region->align;
+    struct segment_node* sn;
+    if (unlikely(posix_memalign((void**) &sn, align, region->header + size) != 0))
+        return nomem_alloc;
+    struct segment_node** entry = (struct segment_node**) vector_push(&(t->allocs), sizeof(struct segment_node*));
+    if (unlikely(!entry)) {
+        free(sn);
+        return nomem_alloc;
+    }
+    *entry = sn;
+    void* segment = (void*) ((uintptr_t) sn + region->header);
+    memset(segment, 0, size);
+    *target = segment;
+    return success_alloc;
+}
+
+// Note: Invisible readers may still be reading a segment that a committed
+// transaction freed. Hence a freed segment is retired at commit time, and only
+// released once every transaction running at that time has ended.
+bool tm_free(shared_t shared, tx_t tx, void* segment) {
+    struct region* region = (struct region*) shared;
+    struct tx* t = (struct tx*) tx;
+    struct segment_node** entry = (struct segment_node**) vector_push(&(t->frees), sizeof(struct segment_node*));
+    if (unlikely(!entry)) {
+        if (t->irrevocable) // Cannot abort, the segment stays allocated until the region is destroyed
+            return true;
+        tx_abort(region, t, cm_abort_other);
+        return false;
+    }
+    *entry = (struct segment_node*) ((uintptr_t) segment - region->header);
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Index returned when a word is not in the write set.
+**/
+#define WRITE_INDEX_NONE SIZE_MAX
+
+/**
+ * @brief Slot of the hash table of a write index.
+ */
+struct write_index_slot {
+    void const* word; // Indexed word
+    uint32_t entry;   // Index of the word in the write set
+    uint32_t stamp;   // Reset count at insertion, the slot being empty if older than the index
+};
+
+/**
+ * @brief Index of the write set of a transaction, mapping the address of a
+ * written word to its position in the write set: a 64-bit bloom filter in
+ * front of an open-addressing hash table with linear probing. A zeroed
+ * structure is a valid, empty index.
+ */
+struct write_index {
+    uint64_t bloom; // Bloom filter of the indexed words
+    uint32_t stamp; // Number of resets, the slots stamped differently are empty
+    size_t   size;  // Number of indexed words
+    size_t   mask;  // Number of slots minus one (the number of slots is 0 or a power of 2)
+    unsigned int shift; // Shift of a hash giving the first slot to probe, i.e. 64 minus the base-2 logarithm of the number of slots
+    struct write_index_slot* slots; // Hash table
+};
+
+/** Clean the given index up.
+ * @param index Index to clean up
+**/
+void write_index_cleanup(struct write_index* index);
+
+/** Empty the given index, in constant time (but for every 2^32 resets).
+ * @param index Index to reset
+**/
+void write_index_reset(struct write_index* index);
+
+/** Insert a word that is not indexed yet.
+ * @param index Index to insert into
+ * @param word  Address of the word
+ * @param entry Index of the word in the write set
+ * @return Whether the operation is a success (it fails on allocation failure)
+**/
+bool write_index_insert(struct write_index* index, void const* word, size_t entry);
+
+/** Hash the given word address.
+ * @param word Address of the word
+ * @return Hash, whose high bits are the best mixed
+**/
+static inline uint64_t write_index_hash(void const* word) {
+    return ((uintptr_t) word >> 3 | (uintptr_t) word << 61) * UINT64_C(0x9E3779B97F4A7C15);
+}
+
+/** Get the bits the given hash sets in the bloom filter.
+ * @param hash Hash of the word
+ * @return Bits of the filter
+**/
+static inline uint64_t write_index_bloom(uint64_t hash) {
+    return (UINT64_C(1) << ((hash >> 32) & 63)) | (UINT64_C(1) << ((hash >> 38) & 63));
+}
+
+/** Find the given word.
+ * @param index Index to query
+ * @param word  Address of the word
+ * @return Index of the word in the write set, 'WRITE_INDEX_NONE' if not written
+**/
+static inline size_t write_index_find(struct write_index const* index, void const* word) {
+    uint64_t hash = write_index_hash(word);
+    uint64_t bits = write_index_bloom(hash);
+    if ((index->bloom & bits) != bits) // Definitely not written
+        return WRITE_INDEX_NONE;
+    for (size_t i = hash >> index->shift;; i = (i + 1) & index->mask) {
+        struct write_index_slot const* slot = index->slots + i;
+        if (slot->stamp != index->stamp)
+            return WRITE_INDEX_NONE;
+        if (slot->word == word)
+            return slot->entry;
+    }
+}